@@ -0,0 +1,203 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include "IIOAttrIndex.hpp"
+#include <stdexcept>
+
+#include <json.hpp>
+using json = nlohmann::json;
+
+static const std::string debugPrefix("debug/");
+
+IIOAttrIndex::IIOAttrIndex(void) : deviceIndexed(true), debugIndexed(true) {}
+
+IIOAttrIndex::IIOAttrIndex(IIODevice dev, const std::vector<IIOChannel> &channels)
+    : dev(std::make_shared<IIODevice>(dev)), channels(channels), deviceIndexed(false), debugIndexed(false) {}
+
+void IIOAttrIndex::indexDevice(void) const
+{
+    if (this->deviceIndexed) return;
+    for (auto a : this->dev->attributes())
+    {
+        this->deviceAttrs.insert(std::make_pair(a.name(), a));
+    }
+    this->deviceIndexed = true;
+}
+
+void IIOAttrIndex::indexDebug(void) const
+{
+    if (this->debugIndexed) return;
+    for (auto a : this->dev->debugAttributes())
+    {
+        this->debugAttrs.insert(std::make_pair(debugPrefix + a.name(), a));
+    }
+    this->debugIndexed = true;
+}
+
+void IIOAttrIndex::indexChannel(const std::string &channelId) const
+{
+    if (this->indexedChannels.count(channelId) != 0) return;
+    for (auto c : this->channels)
+    {
+        if (c.id() != channelId) continue;
+        const std::string prefix = channelId + "/";
+        for (auto a : c.attributes())
+        {
+            this->channelAttrs.insert(std::make_pair(prefix + a.name(), a));
+        }
+    }
+    this->indexedChannels.insert(channelId);
+}
+
+void IIOAttrIndex::indexAll(void) const
+{
+    this->indexDevice();
+    this->indexDebug();
+    for (auto c : this->channels) this->indexChannel(c.id());
+}
+
+bool IIOAttrIndex::contains(const std::string &path) const
+{
+    if (isDebug(path))
+    {
+        this->indexDebug();
+        return this->debugAttrs.count(path) != 0;
+    }
+    const auto slash = path.find('/');
+    if (slash == std::string::npos)
+    {
+        this->indexDevice();
+        return this->deviceAttrs.count(path) != 0;
+    }
+    this->indexChannel(path.substr(0, slash));
+    return this->channelAttrs.count(path) != 0;
+}
+
+bool IIOAttrIndex::isDebug(const std::string &path)
+{
+    return path.compare(0, debugPrefix.size(), debugPrefix) == 0;
+}
+
+std::vector<std::string> IIOAttrIndex::paths(void) const
+{
+    this->indexAll();
+    std::vector<std::string> paths;
+    for (const auto &a : this->deviceAttrs) paths.push_back(a.first);
+    for (const auto &a : this->channelAttrs) paths.push_back(a.first);
+    for (const auto &a : this->debugAttrs) paths.push_back(a.first);
+    return paths;
+}
+
+IIOAttr<IIODevice> IIOAttrIndex::deviceAttribute(const std::string &attr) const
+{
+    this->indexDevice();
+    auto it = this->deviceAttrs.find(attr);
+    if (it == this->deviceAttrs.end())
+    {
+        throw Pothos::NotFoundException("IIOAttrIndex::deviceAttribute()", "attribute not found: " + attr);
+    }
+    return it->second;
+}
+
+IIOAttr<IIOChannel> IIOAttrIndex::channelAttribute(const std::string &channelId, const std::string &attr) const
+{
+    this->indexChannel(channelId);
+    auto it = this->channelAttrs.find(channelId + "/" + attr);
+    if (it == this->channelAttrs.end())
+    {
+        throw Pothos::NotFoundException("IIOAttrIndex::channelAttribute()", "attribute not found: " + channelId + "/" + attr);
+    }
+    return it->second;
+}
+
+IIOAttr<IIODeviceDebug> IIOAttrIndex::debugAttribute(const std::string &path) const
+{
+    this->indexDebug();
+    auto it = this->debugAttrs.find(path);
+    if (it == this->debugAttrs.end())
+    {
+        throw Pothos::NotFoundException("IIOAttrIndex::debugAttribute()", "attribute not found: " + path);
+    }
+    return it->second;
+}
+
+std::string IIOAttrIndex::read(const std::string &path) const
+{
+    if (isDebug(path)) return this->debugAttribute(path).value();
+    const auto slash = path.find('/');
+    if (slash == std::string::npos) return this->deviceAttribute(path).value();
+    return this->channelAttribute(path.substr(0, slash), path.substr(slash + 1)).value();
+}
+
+void IIOAttrIndex::write(const std::string &path, const std::string &value) const
+{
+    const auto slash = path.find('/');
+    if (isDebug(path))
+    {
+        auto a = this->debugAttribute(path);
+        a = value;
+    }
+    else if (slash == std::string::npos)
+    {
+        auto a = this->deviceAttribute(path);
+        a = value;
+    }
+    else
+    {
+        auto a = this->channelAttribute(path.substr(0, slash), path.substr(slash + 1));
+        a = value;
+    }
+}
+
+IIODevice &IIOAttrIndex::registerDevice(const std::string &what) const
+{
+    if (!this->dev)
+    {
+        throw Pothos::SystemException("IIOAttrIndex::" + what + "()", "no device specified");
+    }
+    return *this->dev;
+}
+
+uint32_t IIOAttrIndex::readRegister(uint32_t address) const
+{
+    return this->registerDevice("readRegister").readRegister(address);
+}
+
+void IIOAttrIndex::writeRegister(uint32_t address, uint32_t value) const
+{
+    this->registerDevice("writeRegister").writeRegister(address, value);
+}
+
+std::string IIOAttrIndex::registerTransaction(const std::string &ops) const
+{
+    auto toRegister = [](const json &v) -> uint32_t
+    {
+        if (!v.is_string()) return v.get<uint32_t>();
+        const auto str = v.get<std::string>();
+        size_t pos = 0;
+        const auto value = std::stoul(str, &pos, 0);
+        if (pos != str.size() || value > 0xffffffffUL) throw std::out_of_range(str);
+        return uint32_t(value);
+    };
+
+    //parse everything before touching the device, so that malformed
+    //input is reported as such and no operation is applied
+    std::vector<IIODevice::RegisterOp> regOps;
+    try
+    {
+        for (const auto &op : json::parse(ops))
+        {
+            IIODevice::RegisterOp regOp;
+            regOp.address = toRegister(op.at("address"));
+            regOp.write = op.count("value") != 0;
+            regOp.value = regOp.write ? toRegister(op.at("value")) : 0;
+            regOps.push_back(regOp);
+        }
+    }
+    catch (const std::exception &ex)
+    {
+        throw Pothos::InvalidArgumentException("IIOAttrIndex::registerTransaction()", std::string("invalid register operations: ") + ex.what());
+    }
+
+    json results(this->registerDevice("registerTransaction").registerTransaction(regOps));
+    return results.dump();
+}
@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "IIOSupport.hpp"
+
+/*!
+ * IIOAttrIndex resolves attribute paths on one IIO device and a set of its
+ * channels to attribute objects.
+ *
+ * Device attributes are named "attr", channel attributes are named
+ * "channelId/attr", and device debug attributes are named "debug/attr".
+ * Each owner's attribute names are only listed on the first lookup that
+ * needs them, and no attribute is read until it is accessed, so building
+ * an index costs nothing.
+ */
+class IIOAttrIndex
+{
+private:
+    std::shared_ptr<IIODevice> dev;
+    std::vector<IIOChannel> channels;
+    mutable bool deviceIndexed;
+    mutable bool debugIndexed;
+    mutable std::set<std::string> indexedChannels;
+    mutable std::map<std::string, IIOAttr<IIODevice>> deviceAttrs;
+    mutable std::map<std::string, IIOAttr<IIOChannel>> channelAttrs;
+    mutable std::map<std::string, IIOAttr<IIODeviceDebug>> debugAttrs;
+
+    void indexDevice(void) const;
+    void indexDebug(void) const;
+    void indexChannel(const std::string &channelId) const;
+    void indexAll(void) const;
+    IIOAttr<IIODeviceDebug> debugAttribute(const std::string &path) const;
+    IIODevice &registerDevice(const std::string &what) const;
+
+public:
+    IIOAttrIndex(void);
+    IIOAttrIndex(IIODevice dev, const std::vector<IIOChannel> &channels);
+
+    /*!
+     * Check if the given path names an indexed attribute.
+     */
+    bool contains(const std::string &path) const;
+
+    /*!
+     * Check if the given path names a debug attribute.
+     */
+    static bool isDebug(const std::string &path);
+
+    /*!
+     * Get the paths of every indexed attribute.
+     */
+    std::vector<std::string> paths(void) const;
+
+    /*!
+     * Look up a device attribute by name.
+     * Throws Pothos::NotFoundException if there is no such attribute.
+     */
+    IIOAttr<IIODevice> deviceAttribute(const std::string &attr) const;
+
+    /*!
+     * Look up a channel attribute by channel ID and name.
+     * Throws Pothos::NotFoundException if there is no such attribute.
+     */
+    IIOAttr<IIOChannel> channelAttribute(const std::string &channelId, const std::string &attr) const;
+
+    /*!
+     * Read the attribute with the given path.
+     */
+    std::string read(const std::string &path) const;
+
+    /*!
+     * Write the attribute with the given path.
+     */
+    void write(const std::string &path, const std::string &value) const;
+
+    /*!
+     * Get every attribute of one kind, indexing all of them.
+     */
+    const std::map<std::string, IIOAttr<IIODevice>> &device(void) const { this->indexDevice(); return this->deviceAttrs; }
+    const std::map<std::string, IIOAttr<IIOChannel>> &channel(void) const { this->indexAll(); return this->channelAttrs; }
+    const std::map<std::string, IIOAttr<IIODeviceDebug>> &debug(void) const { this->indexDebug(); return this->debugAttrs; }
+
+    /*!
+     * A getter or setter callable for one attribute, as registered by
+     * the blocks' setAttributeCallables().
+     */
+    struct Callable
+    {
+        std::string name;
+        Pothos::Callable call;
+        bool probe;
+    };
+
+    /*!
+     * Bind the block's getDeviceAttribute/setDeviceAttribute and
+     * getChannelAttribute/setChannelAttribute to every device and channel
+     * attribute, named deviceAttribute[attr], setdeviceAttribute[attr],
+     * channelAttribute[channelId][attr] and
+     * setChannelAttribute[channelId][attr]. The getters are probes.
+     */
+    template <typename BlockType>
+    std::vector<Callable> callables(BlockType &block) const;
+
+    /*!
+     * Read or write a register of the device.
+     */
+    uint32_t readRegister(uint32_t address) const;
+    void writeRegister(uint32_t address, uint32_t value) const;
+
+    /*!
+     * Apply a JSON array of {"address": a} reads and {"address": a,
+     * "value": v} writes, where numbers may be hex strings, and return the
+     * JSON array of values read or written by each operation. The ops are
+     * all parsed before any is applied, and malformed ones are rejected
+     * with Pothos::InvalidArgumentException.
+     */
+    std::string registerTransaction(const std::string &ops) const;
+};
+
+template <typename BlockType>
+std::vector<IIOAttrIndex::Callable> IIOAttrIndex::callables(BlockType &block) const
+{
+    std::vector<Callable> result;
+    for (const auto &entry : this->device())
+    {
+        auto a = entry.second;
+        Pothos::Callable attrGetter(&BlockType::getDeviceAttribute);
+        Pothos::Callable attrSetter(&BlockType::setDeviceAttribute);
+        attrGetter.bind(std::ref(block), 0);
+        attrGetter.bind(a, 1);
+        attrSetter.bind(std::ref(block), 0);
+        attrSetter.bind(a, 1);
+        result.push_back(Callable{"deviceAttribute[" + a.name() + "]", attrGetter, true});
+        result.push_back(Callable{"setdeviceAttribute[" + a.name() + "]", attrSetter, false});
+    }
+    for (const auto &entry : this->channel())
+    {
+        auto a = entry.second;
+        Pothos::Callable attrGetter(&BlockType::getChannelAttribute);
+        Pothos::Callable attrSetter(&BlockType::setChannelAttribute);
+        attrGetter.bind(std::ref(block), 0);
+        attrGetter.bind(a, 1);
+        attrSetter.bind(std::ref(block), 0);
+        attrSetter.bind(a, 1);
+        const std::string cId = a.owner().id();
+        result.push_back(Callable{"channelAttribute[" + cId + "][" + a.name() + "]", attrGetter, true});
+        result.push_back(Callable{"setChannelAttribute[" + cId + "][" + a.name() + "]", attrSetter, false});
+    }
+    return result;
+}
@@ -0,0 +1,192 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include "IIOAttrWatcher.hpp"
+#include <chrono>
+
+IIOAttrWatcher::IIOAttrWatcher(IIODevice dev, const std::vector<IIOChannel> &channels)
+    : dev(dev), channels(channels), stopping(false), interval(1.0) {}
+
+IIOAttrWatcher::~IIOAttrWatcher(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->cond.notify_all();
+    if (this->thread.joinable())
+    {
+        this->thread.join();
+    }
+}
+
+void IIOAttrWatcher::poll(const std::vector<std::string> &paths, std::map<std::string, std::string> &result)
+{
+    //group the paths by owner, so that each owner is read once
+    std::map<std::string, std::vector<std::string>> byOwner;
+    for (const auto &path : paths)
+    {
+        const auto slash = path.find('/');
+        if (slash == std::string::npos) byOwner[""].push_back(path);
+        else byOwner[path.substr(0, slash)].push_back(path.substr(slash + 1));
+    }
+
+    for (const auto &owner : byOwner)
+    {
+        std::map<std::string, std::string> values;
+        if (owner.first.empty())
+        {
+            values = this->dev.readAttributes();
+        }
+        else
+        {
+            for (auto c : this->channels)
+            {
+                if (c.id() == owner.first)
+                {
+                    values = c.readAttributes();
+                    break;
+                }
+            }
+        }
+
+        const std::string prefix = owner.first.empty() ? "" : owner.first + "/";
+        for (const auto &attr : owner.second)
+        {
+            auto it = values.find(attr);
+            if (it != values.end())
+            {
+                result[prefix + attr] = it->second;
+            }
+        }
+    }
+}
+
+void IIOAttrWatcher::threadLoop(void)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (!this->stopping && !this->paths.empty() && this->interval > 0.0)
+    {
+        //read without holding the lock
+        const auto paths = this->paths;
+        const auto interval = this->interval;
+        lock.unlock();
+        std::map<std::string, std::string> result;
+        std::string error;
+        try
+        {
+            this->poll(paths, result);
+        }
+        catch (const Pothos::Exception &ex)
+        {
+            error = ex.displayText();
+        }
+        lock.lock();
+
+        //the watch set may have changed while we were reading
+        if (paths == this->paths)
+        {
+            if (!error.empty())
+            {
+                this->error = error;
+            }
+            for (const auto &r : result)
+            {
+                auto it = this->values.find(r.first);
+                if (it == this->values.end() || it->second != r.second)
+                {
+                    this->values[r.first] = r.second;
+                    this->changes[r.first] = r.second;
+                }
+            }
+            if (!this->changes.empty() || !this->error.empty()) this->changedCond.notify_all();
+        }
+
+        this->cond.wait_for(lock, std::chrono::duration<double>(interval));
+    }
+}
+
+void IIOAttrWatcher::restart(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->cond.notify_all();
+    if (this->thread.joinable())
+    {
+        this->thread.join();
+    }
+
+    this->stopping = false;
+    this->values.clear();
+    this->changes.clear();
+    this->error.clear();
+    if (!this->paths.empty() && this->interval > 0.0)
+    {
+        this->thread = std::thread(&IIOAttrWatcher::threadLoop, this);
+    }
+}
+
+void IIOAttrWatcher::setAttributes(const std::vector<std::string> &paths)
+{
+    //validate the paths up front, so that errors go back to the caller
+    std::map<std::string, std::string> result;
+    this->poll(paths, result);
+    for (const auto &path : paths)
+    {
+        if (result.count(path) == 0)
+        {
+            throw Pothos::NotFoundException("IIOAttrWatcher::setAttributes()", "attribute not found: " + path);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->paths = paths;
+    }
+    this->restart();
+}
+
+void IIOAttrWatcher::setInterval(double interval)
+{
+    if (interval < 0.0)
+    {
+        throw Pothos::InvalidArgumentException("IIOAttrWatcher::setInterval()", "interval must not be negative");
+    }
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->interval = interval;
+    }
+    this->restart();
+}
+
+bool IIOAttrWatcher::takeChanges(std::map<std::string, std::string> &changes)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (!this->error.empty())
+    {
+        const auto error = this->error;
+        this->error.clear();
+        throw Pothos::SystemException("IIOAttrWatcher::takeChanges()", error);
+    }
+    if (this->changes.empty())
+    {
+        return false;
+    }
+    changes.swap(this->changes);
+    this->changes.clear();
+    return true;
+}
+
+bool IIOAttrWatcher::isWatching(void)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return !this->paths.empty() && this->interval > 0.0;
+}
+
+bool IIOAttrWatcher::waitChanges(long long timeoutNs)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    return this->changedCond.wait_for(lock, std::chrono::nanoseconds(timeoutNs),
+        [this]{ return !this->changes.empty() || !this->error.empty(); });
+}
@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "IIOSupport.hpp"
+
+/*!
+ * IIOAttrWatcher polls a set of attributes of one IIO device and its
+ * channels on a background thread, and keeps track of the values that
+ * changed since they were last collected.
+ *
+ * Attributes are named by path: "attr" for a device attribute, and
+ * "channelId/attr" for a channel attribute. Each polled device or channel
+ * is read in bulk, with a single read of all of its attributes.
+ */
+class IIOAttrWatcher
+{
+private:
+    IIODevice dev;
+    std::vector<IIOChannel> channels;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::condition_variable changedCond;
+    bool stopping;
+
+    std::vector<std::string> paths;
+    double interval;
+    std::map<std::string, std::string> values;
+    std::map<std::string, std::string> changes;
+    std::string error;
+
+    void threadLoop(void);
+    void poll(const std::vector<std::string> &paths, std::map<std::string, std::string> &result);
+    void restart(void);
+
+public:
+    IIOAttrWatcher(IIODevice dev, const std::vector<IIOChannel> &channels);
+    ~IIOAttrWatcher(void);
+
+    IIOAttrWatcher(const IIOAttrWatcher&) = delete;
+    IIOAttrWatcher& operator=(const IIOAttrWatcher&) = delete;
+
+    /*!
+     * Set the attribute paths to watch. An empty set stops polling.
+     * Every watched attribute is reported once with its initial value.
+     */
+    void setAttributes(const std::vector<std::string> &paths);
+
+    /*!
+     * Set the polling interval in seconds. Zero stops polling.
+     */
+    void setInterval(double interval);
+
+    /*!
+     * Take the attributes that changed since the last call, mapped from
+     * path to new value. Returns false if nothing changed.
+     *
+     * If the last poll failed, the error is rethrown here.
+     */
+    bool takeChanges(std::map<std::string, std::string> &changes);
+
+    /*!
+     * Check if any attributes are being polled.
+     */
+    bool isWatching(void);
+
+    /*!
+     * Wait up to timeoutNs for changes or a poll error to be ready for
+     * takeChanges(). Returns false on timeout.
+     */
+    bool waitChanges(long long timeoutNs);
+};
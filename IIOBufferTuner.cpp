@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include "IIOBufferTuner.hpp"
+#include <Pothos/Framework.hpp>
+#include <algorithm>
+
+//the number of transfers judged together
+static const size_t tunerWindow = 16;
+
+//the number of calm windows before the buffer shrinks
+static const size_t tunerCalmWindows = 8;
+
+IIOBufferTuner::IIOBufferTuner(void)
+    : minSize(0), maxSize(0), minKernelBuffers(0), maxKernelBuffers(0), size(0), kernelBuffers(0)
+{
+    this->reset();
+}
+
+IIOBufferTuner::IIOBufferTuner(size_t minSize, size_t maxSize, size_t size,
+    size_t minKernelBuffers, size_t maxKernelBuffers)
+    : minSize(minSize), maxSize(maxSize), minKernelBuffers(minKernelBuffers), maxKernelBuffers(maxKernelBuffers),
+    size(std::min(std::max(size, minSize), maxSize)), kernelBuffers(maxKernelBuffers ? minKernelBuffers : 0)
+{
+    if (minSize == 0 || minSize > maxSize)
+    {
+        throw Pothos::RangeException("IIOBufferTuner::IIOBufferTuner()", "buffer size bounds out of order");
+    }
+    if (maxKernelBuffers != 0 && (minKernelBuffers == 0 || minKernelBuffers > maxKernelBuffers))
+    {
+        throw Pothos::RangeException("IIOBufferTuner::IIOBufferTuner()", "kernel buffer bounds out of order");
+    }
+    this->reset();
+}
+
+void IIOBufferTuner::reset(void)
+{
+    this->transfers = 0;
+    this->pressured = 0;
+    this->slack = true;
+    this->calmWindows = 0;
+    this->last = Clock::time_point();
+    this->intervals.clear();
+    this->intervals.reserve(tunerWindow);
+}
+
+void IIOBufferTuner::record(bool pressure, bool slack)
+{
+    const auto now = Clock::now();
+    if (this->last != Clock::time_point())
+    {
+        this->intervals.push_back(std::chrono::duration<double>(now - this->last).count());
+    }
+    this->last = now;
+    this->transfers++;
+    if (pressure) this->pressured++;
+    this->slack = this->slack && slack;
+}
+
+bool IIOBufferTuner::retune(void)
+{
+    if (this->transfers < tunerWindow) return false;
+
+    //transfers that keep arriving late mean the buffer can't hide
+    //scheduling delays; a single late one is tolerated as noise
+    bool pressure = this->pressured != 0;
+    if (!this->intervals.empty())
+    {
+        double mean = 0.0;
+        for (const auto interval : this->intervals) mean += interval;
+        mean /= this->intervals.size();
+        size_t late = 0;
+        for (const auto interval : this->intervals) late += interval > 2 * mean ? 1 : 0;
+        pressure = pressure || late > 1;
+    }
+    const bool slack = this->slack;
+    this->transfers = 0;
+    this->pressured = 0;
+    this->slack = true;
+    this->intervals.clear();
+
+    const size_t oldSize = this->size, oldKernelBuffers = this->kernelBuffers;
+    if (pressure)
+    {
+        this->calmWindows = 0;
+        if (this->size < this->maxSize) this->size = std::min(this->size * 2, this->maxSize);
+        else if (this->kernelBuffers < this->maxKernelBuffers) this->kernelBuffers++;
+    }
+    else if (!slack)
+    {
+        this->calmWindows = 0;
+    }
+    else if (++this->calmWindows >= tunerCalmWindows)
+    {
+        this->calmWindows = 0;
+        if (this->kernelBuffers > this->minKernelBuffers) this->kernelBuffers--;
+        else if (this->size > this->minSize) this->size = std::max(this->size / 2, this->minSize);
+    }
+
+    //the next window starts timing from the new buffer
+    const bool changed = this->size != oldSize || this->kernelBuffers != oldKernelBuffers;
+    if (changed) this->last = Clock::time_point();
+    return changed;
+}
@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+/*!
+ * IIOBufferTuner picks the size of an IIO buffer, and optionally the number
+ * of kernel buffers behind it, from telemetry recorded at every refill or
+ * push, so that a stream uses small buffers for latency while it keeps up
+ * and large ones while it doesn't.
+ *
+ * Transfers are judged in windows of 16. A window under pressure, where a
+ * transfer reported an overflow, underflow or stall, or where more than one
+ * interval between transfers was over twice their mean, doubles the buffer
+ * size, or once that is at its maximum adds a kernel buffer. Eight windows
+ * in a row without pressure, in which the other side of the block always
+ * had room to spare, give back a kernel buffer, or once those are at their
+ * minimum halve the buffer size.
+ */
+class IIOBufferTuner
+{
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    size_t minSize;
+    size_t maxSize;
+    size_t minKernelBuffers;
+    size_t maxKernelBuffers;
+    size_t size;
+    size_t kernelBuffers;
+    size_t transfers;
+    size_t pressured;
+    bool slack;
+    size_t calmWindows;
+    Clock::time_point last;
+    std::vector<double> intervals;
+
+public:
+    IIOBufferTuner(void);
+
+    /*!
+     * Tune a buffer between minSize and maxSize samples, starting from
+     * size. Kernel buffers are tuned between minKernelBuffers and
+     * maxKernelBuffers, or left alone when maxKernelBuffers is 0.
+     */
+    IIOBufferTuner(size_t minSize, size_t maxSize, size_t size,
+        size_t minKernelBuffers, size_t maxKernelBuffers);
+
+    /*!
+     * Record one transfer. pressure reports an overflow, underflow or stall
+     * since the last one, and slack that the other side of the block has
+     * room for more than twice the buffer.
+     */
+    void record(bool pressure, bool slack);
+
+    /*!
+     * Forget the telemetry so far, such as when the stream restarts.
+     */
+    void reset(void);
+
+    /*!
+     * At the end of a window, pick the buffer size and kernel buffer count
+     * for the next one. Returns true if either changed.
+     */
+    bool retune(void);
+
+    /*!
+     * Get the tuned buffer size, in samples.
+     */
+    size_t bufferSize(void) const { return this->size; }
+
+    /*!
+     * Get the tuned kernel buffer count, or 0 when not tuned.
+     */
+    size_t kernelBufferCount(void) const { return this->kernelBuffers; }
+};
@@ -0,0 +1,434 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include "IIOCalibration.hpp"
+#include "IIOMonitor.hpp"
+#include <Pothos/Framework.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+
+#include <json.hpp>
+using json = nlohmann::json;
+
+//the widest channel compiled into a lookup table, in bits
+static const unsigned int tableBits = 16;
+
+static json parseCalibration(const std::string &text)
+{
+    try
+    {
+        return json::parse(text);
+    }
+    catch (const std::exception &ex)
+    {
+        throw Pothos::InvalidArgumentException("IIOCalibration", std::string("invalid calibration: ") + ex.what());
+    }
+}
+
+static double evaluate(const std::vector<double> &polynomial, const double x)
+{
+    double y = 0.0;
+    for (auto it = polynomial.rbegin(); it != polynomial.rend(); ++it) y = y * x + *it;
+    return y;
+}
+
+IIOCalibration::IIOCalibration(void) : length(0), isSigned(false), lowCode(0), highCode(0) {}
+
+IIOCalibration::IIOCalibration(const IIOScanElement &element, const std::string &spec, bool inverse)
+    : length(element.length), isSigned(element.isSigned)
+{
+    if (!IIOChannelStats::supports(element))
+    {
+        throw Pothos::InvalidArgumentException("IIOCalibration::IIOCalibration()", "unsupported channel format");
+    }
+    const unsigned int bits = std::min<unsigned int>(element.bits ? element.bits : element.length * 8, 63);
+    this->lowCode = this->isSigned ? -(int64_t(1) << (bits - 1)) : 0;
+    this->highCode = this->isSigned ? (int64_t(1) << (bits - 1)) - 1 : (int64_t(1) << bits) - 1;
+
+    //every kind of correction is a polynomial or a table
+    const auto obj = parseCalibration(spec);
+    std::vector<double> polynomial, table;
+    if (obj.count("table")) table = obj.at("table").get<std::vector<double>>();
+    else if (obj.count("polynomial")) polynomial = obj.at("polynomial").get<std::vector<double>>();
+    else if (obj.count("gain") || obj.count("offset"))
+    {
+        polynomial.push_back(obj.count("offset") ? obj.at("offset").get<double>() : 0.0);
+        polynomial.push_back(obj.count("gain") ? obj.at("gain").get<double>() : 1.0);
+    }
+    else throw Pothos::InvalidArgumentException("IIOCalibration::IIOCalibration()", "unknown correction: " + spec);
+
+    //wide channels evaluate linear corrections per sample
+    if (bits > tableBits)
+    {
+        if (!table.empty() || (inverse && polynomial.size() > 2))
+        {
+            throw Pothos::InvalidArgumentException("IIOCalibration::IIOCalibration()",
+                "only linear corrections are supported for channels wider than 16 bits");
+        }
+        this->polynomial = polynomial;
+        if (inverse)
+        {
+            const double offset = polynomial.empty() ? 0.0 : polynomial[0];
+            const double gain = polynomial.size() > 1 ? polynomial[1] : 0.0;
+            if (gain == 0.0)
+            {
+                throw Pothos::InvalidArgumentException("IIOCalibration::IIOCalibration()", "correction has no inverse");
+            }
+            this->polynomial = {-offset / gain, 1.0 / gain};
+        }
+        return;
+    }
+
+    //the corrected value of every code
+    const size_t codeCount = size_t(this->highCode - this->lowCode + 1);
+    if (!table.empty() && table.size() != codeCount)
+    {
+        throw Pothos::InvalidArgumentException("IIOCalibration::IIOCalibration()",
+            "table needs one entry per code: " + std::to_string(codeCount));
+    }
+    std::vector<double> codes(table);
+    if (codes.empty())
+    {
+        codes.resize(codeCount);
+        for (size_t i = 0; i < codeCount; ++i) codes[i] = evaluate(polynomial, double(this->lowCode + int64_t(i)));
+    }
+
+    //invert by sweeping the targets over the codes sorted by their corrections
+    if (inverse)
+    {
+        std::vector<size_t> order(codeCount);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&codes](size_t a, size_t b){ return codes[a] < codes[b]; });
+        std::vector<double> inverseCodes(codeCount);
+        size_t p = 0;
+        for (size_t i = 0; i < codeCount; ++i)
+        {
+            const double target = double(this->lowCode + int64_t(i));
+            while (p + 1 < codeCount && std::abs(codes[order[p + 1]] - target) <= std::abs(codes[order[p]] - target)) ++p;
+            inverseCodes[i] = double(this->lowCode + int64_t(order[p]));
+        }
+        codes.swap(inverseCodes);
+    }
+
+    switch (this->length)
+    {
+    #define IIO_CALIBRATION_COMPILE(S, U) \
+        if (this->isSigned) this->compile<S>(codes); \
+        else this->compile<U>(codes); \
+        break;
+    case 1: IIO_CALIBRATION_COMPILE(int8_t, uint8_t)
+    case 2: IIO_CALIBRATION_COMPILE(int16_t, uint16_t)
+    case 4: IIO_CALIBRATION_COMPILE(int32_t, uint32_t)
+    case 8: IIO_CALIBRATION_COMPILE(int64_t, uint64_t)
+    #undef IIO_CALIBRATION_COMPILE
+    }
+}
+
+template <typename T>
+void IIOCalibration::compile(const std::vector<double> &codes)
+{
+    const double low = double(this->lowCode), high = double(this->highCode);
+    this->table.resize(codes.size() * sizeof(T));
+    T *table = reinterpret_cast<T *>(this->table.data());
+    for (size_t i = 0; i < codes.size(); ++i)
+    {
+        table[i] = T(int64_t(std::nearbyint(std::min(std::max(codes[i], low), high))));
+    }
+}
+
+template <typename T>
+void IIOCalibration::applyType(T *samples, size_t n) const
+{
+    //codes outside the significant bits are wrapped rather than trusted
+    if (!this->table.empty())
+    {
+        const T *table = reinterpret_cast<const T *>(this->table.data());
+        const uint64_t low = uint64_t(this->lowCode);
+        const uint64_t mask = uint64_t(this->highCode - this->lowCode);
+        for (size_t i = 0; i < n; ++i) samples[i] = table[(uint64_t(int64_t(samples[i])) - low) & mask];
+        return;
+    }
+
+    const double low = double(this->lowCode), high = double(this->highCode);
+    for (size_t i = 0; i < n; ++i)
+    {
+        const double y = evaluate(this->polynomial, double(samples[i]));
+        samples[i] = T(int64_t(std::nearbyint(std::min(std::max(y, low), high))));
+    }
+}
+
+void IIOCalibration::apply(void *samples, size_t n) const
+{
+    switch (this->length)
+    {
+    #define IIO_CALIBRATION_APPLY(S, U) \
+        if (this->isSigned) this->applyType(static_cast<S *>(samples), n); \
+        else this->applyType(static_cast<U *>(samples), n); \
+        break;
+    case 1: IIO_CALIBRATION_APPLY(int8_t, uint8_t)
+    case 2: IIO_CALIBRATION_APPLY(int16_t, uint16_t)
+    case 4: IIO_CALIBRATION_APPLY(int32_t, uint32_t)
+    case 8: IIO_CALIBRATION_APPLY(int64_t, uint64_t)
+    #undef IIO_CALIBRATION_APPLY
+    }
+}
+
+std::map<std::string, std::string> IIOCalibration::load(const std::string &calibration, const std::string &deviceId)
+{
+    std::map<std::string, std::string> specs;
+    const auto first = std::find_if(calibration.begin(), calibration.end(),
+        [](char c){ return !std::isspace(static_cast<unsigned char>(c)); });
+    if (first == calibration.end()) return specs;
+
+    //anything but a JSON object is a file path
+    std::string text(calibration);
+    if (*first != '{')
+    {
+        std::ifstream file(calibration);
+        if (!file)
+        {
+            throw Pothos::NotFoundException("IIOCalibration::load()", "cannot open calibration file: " + calibration);
+        }
+        text.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    const auto obj = parseCalibration(text);
+    if (!obj.is_object())
+    {
+        throw Pothos::InvalidArgumentException("IIOCalibration::load()", "calibration must be a JSON object");
+    }
+    const auto device = obj.find(deviceId);
+    if (device == obj.end()) return specs;
+    for (auto it = device->begin(); it != device->end(); ++it)
+    {
+        specs[it.key()] = it.value().dump();
+    }
+    return specs;
+}
+
+/***********************************************************************
+ * DC offset removal
+ **********************************************************************/
+static double smoothing(const size_t n, const double timeConstant)
+{
+    return timeConstant > 0.0 ? 1.0 - std::exp(-double(n) / timeConstant) : 1.0;
+}
+
+IIODCBlocker::IIODCBlocker(void)
+    : length(0), isSigned(false), lowCode(0), highCode(0), timeConstant(0.0), estimate(0.0), settled(false) {}
+
+IIODCBlocker::IIODCBlocker(const IIOScanElement &element, double timeConstant)
+    : length(element.length), isSigned(element.isSigned), timeConstant(timeConstant), estimate(0.0), settled(false)
+{
+    if (!IIOChannelStats::supports(element))
+    {
+        throw Pothos::InvalidArgumentException("IIODCBlocker::IIODCBlocker()", "unsupported channel format");
+    }
+    const unsigned int bits = std::min<unsigned int>(element.bits ? element.bits : element.length * 8, 63);
+    this->lowCode = this->isSigned ? -(int64_t(1) << (bits - 1)) : 0;
+    this->highCode = this->isSigned ? (int64_t(1) << (bits - 1)) - 1 : (int64_t(1) << bits) - 1;
+}
+
+template <typename T>
+void IIODCBlocker::applyType(T *samples, size_t n)
+{
+    //plain integer loops that the compiler can vectorize
+    int64_t sum = 0;
+    for (size_t i = 0; i < n; ++i) sum += int64_t(samples[i]);
+    const double mean = double(sum) / n;
+    this->estimate = this->settled ? this->estimate + smoothing(n, this->timeConstant) * (mean - this->estimate) : mean;
+    this->settled = true;
+
+    //unsigned channels are centred on mid-scale
+    const int64_t centre = this->isSigned ? 0 : (this->highCode + 1) / 2;
+    const int64_t offset = int64_t(std::nearbyint(this->estimate)) - centre;
+    const int64_t low = this->lowCode, high = this->highCode;
+    for (size_t i = 0; i < n; ++i)
+    {
+        samples[i] = T(std::min(std::max(int64_t(samples[i]) - offset, low), high));
+    }
+}
+
+void IIODCBlocker::apply(void *samples, size_t n)
+{
+    if (n == 0) return;
+    switch (this->length)
+    {
+    #define IIO_DC_BLOCKER_APPLY(S, U) \
+        if (this->isSigned) this->applyType(static_cast<S *>(samples), n); \
+        else this->applyType(static_cast<U *>(samples), n); \
+        break;
+    case 1: IIO_DC_BLOCKER_APPLY(int8_t, uint8_t)
+    case 2: IIO_DC_BLOCKER_APPLY(int16_t, uint16_t)
+    case 4: IIO_DC_BLOCKER_APPLY(int32_t, uint32_t)
+    case 8: IIO_DC_BLOCKER_APPLY(int64_t, uint64_t)
+    #undef IIO_DC_BLOCKER_APPLY
+    }
+}
+
+/***********************************************************************
+ * I/Q imbalance correction
+ **********************************************************************/
+IIOIQBalancer::IIOIQBalancer(void)
+    : length(0), isSigned(false), lowCode(0), highCode(0), timeConstant(0.0),
+    powerI(0.0), powerQ(0.0), correlation(0.0), settled(false) {}
+
+IIOIQBalancer::IIOIQBalancer(const IIOScanElement &elementI, const IIOScanElement &elementQ, double timeConstant)
+    : length(elementQ.length), isSigned(elementQ.isSigned), timeConstant(timeConstant),
+    powerI(0.0), powerQ(0.0), correlation(0.0), settled(false)
+{
+    if (!IIOChannelStats::supports(elementI) || !IIOChannelStats::supports(elementQ))
+    {
+        throw Pothos::InvalidArgumentException("IIOIQBalancer::IIOIQBalancer()", "unsupported channel format");
+    }
+    if (elementI.length != elementQ.length || elementI.isSigned != elementQ.isSigned)
+    {
+        throw Pothos::InvalidArgumentException("IIOIQBalancer::IIOIQBalancer()", "I and Q channel formats differ");
+    }
+    const unsigned int bits = std::min<unsigned int>(elementQ.bits ? elementQ.bits : elementQ.length * 8, 63);
+    this->lowCode = this->isSigned ? -(int64_t(1) << (bits - 1)) : 0;
+    this->highCode = this->isSigned ? (int64_t(1) << (bits - 1)) - 1 : (int64_t(1) << bits) - 1;
+}
+
+double IIOIQBalancer::amplitudeRatio(void) const
+{
+    return this->powerI > 0.0 ? std::sqrt(this->powerQ / this->powerI) : 1.0;
+}
+
+double IIOIQBalancer::phaseError(void) const
+{
+    const double norm = std::sqrt(this->powerI * this->powerQ);
+    return norm > 0.0 ? std::asin(std::max(-1.0, std::min(1.0, this->correlation / norm))) : 0.0;
+}
+
+template <typename T>
+void IIOIQBalancer::applyType(const T *i, T *q, size_t n)
+{
+    //plain reductions that the compiler can vectorize; unsigned channels
+    //are centred on mid-scale
+    const double centre = this->isSigned ? 0.0 : double((this->highCode + 1) / 2);
+    double sumII = 0.0, sumQQ = 0.0, sumIQ = 0.0;
+    for (size_t k = 0; k < n; ++k)
+    {
+        const double x = double(i[k]) - centre, y = double(q[k]) - centre;
+        sumII += x * x;
+        sumQQ += y * y;
+        sumIQ += x * y;
+    }
+    const double w = this->settled ? smoothing(n, this->timeConstant) : 1.0;
+    this->powerI += w * (sumII / n - this->powerI);
+    this->powerQ += w * (sumQQ / n - this->powerQ);
+    this->correlation += w * (sumIQ / n - this->correlation);
+    this->settled = true;
+
+    //without signal there is nothing to estimate from
+    if (this->powerI <= 0.0 || this->powerQ <= 0.0) return;
+    const double phase = this->phaseError();
+    const double a = 1.0 / (this->amplitudeRatio() * std::cos(phase));
+    const double b = -std::tan(phase);
+    const double low = double(this->lowCode), high = double(this->highCode);
+    for (size_t k = 0; k < n; ++k)
+    {
+        const double y = a * (double(q[k]) - centre) + b * (double(i[k]) - centre) + centre;
+        q[k] = T(int64_t(std::nearbyint(std::min(std::max(y, low), high))));
+    }
+}
+
+void IIOIQBalancer::apply(const void *i, void *q, size_t n)
+{
+    if (n == 0) return;
+    switch (this->length)
+    {
+    #define IIO_IQ_BALANCER_APPLY(S, U) \
+        if (this->isSigned) this->applyType(static_cast<const S *>(i), static_cast<S *>(q), n); \
+        else this->applyType(static_cast<const U *>(i), static_cast<U *>(q), n); \
+        break;
+    case 1: IIO_IQ_BALANCER_APPLY(int8_t, uint8_t)
+    case 2: IIO_IQ_BALANCER_APPLY(int16_t, uint16_t)
+    case 4: IIO_IQ_BALANCER_APPLY(int32_t, uint32_t)
+    case 8: IIO_IQ_BALANCER_APPLY(int64_t, uint64_t)
+    #undef IIO_IQ_BALANCER_APPLY
+    }
+}
+
+/***********************************************************************
+ * Float quantization
+ **********************************************************************/
+IIOSampleQuantizer::IIOSampleQuantizer(void)
+    : length(0), isSigned(false), lowCode(0), highCode(0), centre(0.0), scale(0.0), dither(false), seed(1) {}
+
+IIOSampleQuantizer::IIOSampleQuantizer(const IIOScanElement &element, double fullScale, bool dither)
+    : length(element.length), isSigned(element.isSigned), dither(dither), seed(0x9e3779b9)
+{
+    if (!IIOChannelStats::supports(element))
+    {
+        throw Pothos::InvalidArgumentException("IIOSampleQuantizer::IIOSampleQuantizer()", "unsupported channel format");
+    }
+    if (!(fullScale > 0.0))
+    {
+        throw Pothos::RangeException("IIOSampleQuantizer::IIOSampleQuantizer()", "full scale must be positive");
+    }
+    const unsigned int bits = std::min<unsigned int>(element.bits ? element.bits : element.length * 8, 63);
+    this->lowCode = this->isSigned ? -(int64_t(1) << (bits - 1)) : 0;
+    this->highCode = this->isSigned ? (int64_t(1) << (bits - 1)) - 1 : (int64_t(1) << bits) - 1;
+    this->centre = this->isSigned ? 0.0 : double((this->highCode + 1) / 2);
+    this->scale = (double(this->highCode) - this->centre) / fullScale;
+}
+
+template <typename T>
+unsigned long long IIOSampleQuantizer::quantizeType(const float *in, size_t stride, T *out, size_t n)
+{
+    const double low = double(this->lowCode), high = double(this->highCode);
+    const double centre = this->centre, scale = this->scale;
+
+    //NaN maps to the centre code, and counts as saturated
+    const double mid = std::min(std::max(std::nearbyint(centre), low), high);
+    unsigned long long saturated = 0;
+    if (!this->dither)
+    {
+        //a plain loop that the compiler can vectorize
+        for (size_t i = 0; i < n; ++i)
+        {
+            const double v = std::nearbyint(centre + scale * double(in[i * stride]));
+            saturated += (v < low) + (v > high) + (v != v);
+            out[i] = T(int64_t(std::min(std::max(v == v ? v : mid, low), high)));
+        }
+        return saturated;
+    }
+
+    //triangular dither from the difference of two uniform xorshift draws
+    uint32_t s = this->seed;
+    const auto next = [&s]() -> double
+    {
+        s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+        return double(s) * (1.0 / 4294967296.0);
+    };
+    for (size_t i = 0; i < n; ++i)
+    {
+        const double d = next() - next();
+        const double v = std::nearbyint(centre + scale * double(in[i * stride]) + d);
+        saturated += (v < low) + (v > high) + (v != v);
+        out[i] = T(int64_t(std::min(std::max(v == v ? v : mid, low), high)));
+    }
+    this->seed = s;
+    return saturated;
+}
+
+unsigned long long IIOSampleQuantizer::quantize(const float *in, size_t stride, void *out, size_t n)
+{
+    switch (this->length)
+    {
+    #define IIO_QUANTIZER_QUANTIZE(S, U) \
+        return this->isSigned ? this->quantizeType(in, stride, static_cast<S *>(out), n) : \
+            this->quantizeType(in, stride, static_cast<U *>(out), n);
+    case 1: IIO_QUANTIZER_QUANTIZE(int8_t, uint8_t)
+    case 2: IIO_QUANTIZER_QUANTIZE(int16_t, uint16_t)
+    case 4: IIO_QUANTIZER_QUANTIZE(int32_t, uint32_t)
+    case 8: IIO_QUANTIZER_QUANTIZE(int64_t, uint64_t)
+    #undef IIO_QUANTIZER_QUANTIZE
+    }
+    return 0;
+}
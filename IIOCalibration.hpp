@@ -0,0 +1,190 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "IIOKernels.hpp"
+
+/*!
+ * IIOCalibration corrects one channel's host format samples in place, in
+ * raw codes, saturating at the channel's full-scale codes.
+ *
+ * A correction is given as a JSON object, one of:
+ *  - {"gain": g, "offset": o}, mapping code x to o + g * x
+ *  - {"polynomial": [c0, c1, ...]}, mapping code x to c0 + c1 * x + ...
+ *  - {"table": [y0, y1, ...]}, mapping each code, from the lowest, to y
+ *
+ * For channels of up to 16 significant bits the correction is compiled
+ * into a lookup table indexed by code, so that every kind costs one load
+ * per sample. The inverse correction, for predistorting output samples,
+ * maps each code to the code whose correction is nearest to it; wider
+ * channels can only invert linear corrections.
+ */
+class IIOCalibration
+{
+private:
+    size_t length;
+    bool isSigned;
+    int64_t lowCode;
+    int64_t highCode;
+    std::vector<double> polynomial;
+    std::vector<char> table;
+
+    template <typename T>
+    void compile(const std::vector<double> &codes);
+    template <typename T>
+    void applyType(T *samples, size_t n) const;
+
+public:
+    IIOCalibration(void);
+
+    /*!
+     * Parse the correction spec for samples with the given scan element
+     * format, which must be supported by IIOChannelStats. With inverse set,
+     * the correction is undone instead.
+     */
+    IIOCalibration(const IIOScanElement &element, const std::string &spec, bool inverse = false);
+
+    /*!
+     * Correct n samples in place.
+     */
+    void apply(void *samples, size_t n) const;
+
+    /*!
+     * Load the corrections for one device from calibration, which is either
+     * a JSON object or the path of a file holding one, keyed by device ID
+     * and then channel ID. Returns the spec of each of the device's
+     * channels.
+     */
+    static std::map<std::string, std::string> load(const std::string &calibration, const std::string &deviceId);
+};
+
+/*!
+ * IIODCBlocker removes a tracked DC offset from one channel's host format
+ * samples in place, in raw codes, saturating at the channel's full scale.
+ *
+ * The offset is the mean of each chunk, smoothed with the given time
+ * constant in samples, and is removed rounded to a whole code, moving the
+ * mean to zero, or to mid-scale for unsigned channels.
+ */
+class IIODCBlocker
+{
+private:
+    size_t length;
+    bool isSigned;
+    int64_t lowCode;
+    int64_t highCode;
+    double timeConstant;
+    double estimate;
+    bool settled;
+
+    template <typename T>
+    void applyType(T *samples, size_t n);
+
+public:
+    IIODCBlocker(void);
+
+    /*!
+     * Track samples with the given scan element format, which must be
+     * supported by IIOChannelStats.
+     */
+    IIODCBlocker(const IIOScanElement &element, double timeConstant);
+
+    /*!
+     * Update the offset with n samples and remove it from them.
+     */
+    void apply(void *samples, size_t n);
+
+    /*!
+     * Get the tracked offset, in codes.
+     */
+    double offset(void) const { return this->estimate; }
+};
+
+/*!
+ * IIOIQBalancer corrects the gain and phase imbalance between the I and Q
+ * channels of a complex signal, in raw codes, by replacing Q with the
+ * combination a * Q + b * I that matches the power of I and is orthogonal
+ * to it. The powers and correlation of I and Q are tracked from each chunk
+ * with the given time constant in samples. I is left unchanged.
+ */
+class IIOIQBalancer
+{
+private:
+    size_t length;
+    bool isSigned;
+    int64_t lowCode;
+    int64_t highCode;
+    double timeConstant;
+    double powerI;
+    double powerQ;
+    double correlation;
+    bool settled;
+
+    template <typename T>
+    void applyType(const T *i, T *q, size_t n);
+
+public:
+    IIOIQBalancer(void);
+
+    /*!
+     * Balance I and Q samples with the given scan element formats, which
+     * must be the same and supported by IIOChannelStats.
+     */
+    IIOIQBalancer(const IIOScanElement &elementI, const IIOScanElement &elementQ, double timeConstant);
+
+    /*!
+     * Update the estimates with n sample pairs and correct Q in place.
+     */
+    void apply(const void *i, void *q, size_t n);
+
+    /*!
+     * Get the estimated amplitude ratio of Q to I.
+     */
+    double amplitudeRatio(void) const;
+
+    /*!
+     * Get the estimated phase error of Q, in radians.
+     */
+    double phaseError(void) const;
+};
+
+/*!
+ * IIOSampleQuantizer converts float samples to one channel's host format
+ * codes, mapping +/- full scale onto the channel's significant bits, or
+ * around mid-scale for unsigned channels, and saturating beyond them.
+ * Optional triangular dither of +/- 1 code decorrelates the rounding error
+ * from the signal.
+ */
+class IIOSampleQuantizer
+{
+private:
+    size_t length;
+    bool isSigned;
+    int64_t lowCode;
+    int64_t highCode;
+    double centre;
+    double scale;
+    bool dither;
+    uint32_t seed;
+
+    template <typename T>
+    unsigned long long quantizeType(const float *in, size_t stride, T *out, size_t n);
+
+public:
+    IIOSampleQuantizer(void);
+
+    /*!
+     * Quantize to samples with the given scan element format, which must be
+     * supported by IIOChannelStats.
+     */
+    IIOSampleQuantizer(const IIOScanElement &element, double fullScale, bool dither = false);
+
+    /*!
+     * Convert n floats, stride apart, and return how many saturated.
+     */
+    unsigned long long quantize(const float *in, size_t stride, void *out, size_t n);
+};
@@ -0,0 +1,211 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include "IIOCapture.hpp"
+#include <Pothos/Framework.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+/***********************************************************************
+ * Sample fifo
+ **********************************************************************/
+IIOSampleFifo::IIOSampleFifo(void) : capacity(0), head(0), count(0), popped(0) {}
+
+void IIOSampleFifo::reset(const std::vector<size_t> &sampleSizes, size_t capacity)
+{
+    this->sizes = sampleSizes;
+    this->capacity = capacity;
+    this->data.assign(sampleSizes.size(), std::vector<char>());
+    for (size_t c = 0; c < this->data.size(); ++c)
+    {
+        this->data[c].resize(capacity * sampleSizes[c]);
+    }
+    this->clear();
+}
+
+void IIOSampleFifo::clear(void)
+{
+    this->head = 0;
+    this->count = 0;
+    this->popped = 0;
+}
+
+void IIOSampleFifo::write(size_t channel, size_t at, const char *in, size_t n)
+{
+    //copy to the ring position at samples past the head, wrapping once
+    const size_t size = this->sizes[channel];
+    const size_t pos = (this->head + at) % this->capacity;
+    const size_t first = std::min(n, this->capacity - pos);
+    auto &d = this->data[channel];
+    std::memcpy(d.data() + pos * size, in, first * size);
+    std::memcpy(d.data(), in + first * size, (n - first) * size);
+}
+
+void IIOSampleFifo::read(size_t channel, size_t at, char *out, size_t n) const
+{
+    const size_t size = this->sizes[channel];
+    const size_t pos = (this->head + at) % this->capacity;
+    const size_t first = std::min(n, this->capacity - pos);
+    const auto &d = this->data[channel];
+    std::memcpy(out, d.data() + pos * size, first * size);
+    std::memcpy(out + first * size, d.data(), (n - first) * size);
+}
+
+void IIOSampleFifo::append(void *const *inputs, size_t offset, size_t n)
+{
+    if (n == 0) return;
+    if (n > this->room())
+    {
+        throw Pothos::RangeException("IIOSampleFifo::append()", "fifo overflow");
+    }
+    for (size_t c = 0; c < this->data.size(); ++c)
+    {
+        const auto in = static_cast<const char *>(inputs[c]) + offset * this->sizes[c];
+        this->write(c, this->count, in, n);
+    }
+    this->count += n;
+}
+
+void IIOSampleFifo::append(const IIOSampleFifo &other, size_t offset, size_t n)
+{
+    if (n == 0) return;
+    if (n > this->room())
+    {
+        throw Pothos::RangeException("IIOSampleFifo::append()", "fifo overflow");
+    }
+
+    //the other ring may wrap as well, so copy its two spans separately
+    const size_t pos = (other.head + offset) % other.capacity;
+    const size_t first = std::min(n, other.capacity - pos);
+    for (size_t c = 0; c < this->data.size(); ++c)
+    {
+        const auto &d = other.data[c];
+        this->write(c, this->count, d.data() + pos * this->sizes[c], first);
+        this->write(c, this->count + first, d.data(), n - first);
+    }
+    this->count += n;
+}
+
+void IIOSampleFifo::pop(void *const *outputs, size_t n)
+{
+    if (n == 0) return;
+    for (size_t c = 0; c < this->data.size(); ++c)
+    {
+        this->read(c, 0, static_cast<char *>(outputs[c]), n);
+    }
+    this->discard(n);
+}
+
+void IIOSampleFifo::discard(size_t n)
+{
+    if (n == 0) return;
+    this->head = (this->head + n) % this->capacity;
+    this->count -= n;
+    this->popped += n;
+}
+
+/***********************************************************************
+ * Level trigger
+ **********************************************************************/
+IIOLevelTrigger::IIOLevelTrigger(void)
+    : length(0), isSigned(false), level(0.0), edge(Rising), hysteresis(0.0), holdoff(0),
+    armedRising(false), armedFalling(false), holdoffRemaining(0) {}
+
+IIOLevelTrigger::IIOLevelTrigger(const IIOScanElement &element, double level, Edge edge,
+    double hysteresis, unsigned long long holdoff)
+    : length(element.length), isSigned(element.isSigned), level(level), edge(edge), hysteresis(hysteresis),
+    holdoff(holdoff), armedRising(false), armedFalling(false), holdoffRemaining(0)
+{
+    const bool supported = element.repeat == 1 &&
+        (this->length == 1 || this->length == 2 || this->length == 4 || this->length == 8);
+    if (!supported)
+    {
+        throw Pothos::InvalidArgumentException("IIOLevelTrigger::IIOLevelTrigger()", "unsupported trigger channel format");
+    }
+    if (hysteresis < 0.0)
+    {
+        throw Pothos::RangeException("IIOLevelTrigger::IIOLevelTrigger()", "negative hysteresis");
+    }
+}
+
+void IIOLevelTrigger::reset(void)
+{
+    this->armedRising = false;
+    this->armedFalling = false;
+}
+
+//the number of samples covered by one minimum/maximum check
+static const size_t scanBlock = 256;
+
+template <typename T>
+size_t IIOLevelTrigger::findType(const T *samples, size_t n)
+{
+    const bool rising = this->edge != Falling;
+    const bool falling = this->edge != Rising;
+    const double fireLevel = this->level;
+    const double riseArmLevel = this->level - this->hysteresis;
+    const double fallArmLevel = this->level + this->hysteresis;
+
+    //crossings within the holdoff are ignored
+    size_t i = size_t(std::min<unsigned long long>(n, this->holdoffRemaining));
+    this->holdoffRemaining -= i;
+
+    while (i < n)
+    {
+        const size_t blockEnd = std::min(n, i + scanBlock);
+
+        //a plain reduction that the compiler can vectorize
+        T lo = samples[i], hi = samples[i];
+        for (size_t j = i + 1; j < blockEnd; ++j)
+        {
+            lo = std::min(lo, samples[j]);
+            hi = std::max(hi, samples[j]);
+        }
+        const bool mayRise = rising && (this->armedRising ? double(hi) >= fireLevel : double(lo) < riseArmLevel);
+        const bool mayFall = falling && (this->armedFalling ? double(lo) <= fireLevel : double(hi) > fallArmLevel);
+        if (!mayRise && !mayFall)
+        {
+            i = blockEnd;
+            continue;
+        }
+
+        for (; i < blockEnd; ++i)
+        {
+            const double v = double(samples[i]);
+            bool fire = false;
+            if (rising)
+            {
+                if (this->armedRising && v >= fireLevel) fire = true;
+                else if (v < riseArmLevel) this->armedRising = true;
+            }
+            if (falling)
+            {
+                if (this->armedFalling && v <= fireLevel) fire = true;
+                else if (v > fallArmLevel) this->armedFalling = true;
+            }
+            if (fire)
+            {
+                this->reset();
+                this->holdoffRemaining = this->holdoff;
+                return i;
+            }
+        }
+    }
+    return n;
+}
+
+size_t IIOLevelTrigger::find(const void *samples, size_t n)
+{
+    switch (this->length)
+    {
+    #define IIO_LEVEL_TRIGGER_FIND(S, U) \
+        return this->isSigned ? this->findType(static_cast<const S *>(samples), n) : \
+            this->findType(static_cast<const U *>(samples), n);
+    case 1: IIO_LEVEL_TRIGGER_FIND(int8_t, uint8_t)
+    case 2: IIO_LEVEL_TRIGGER_FIND(int16_t, uint16_t)
+    case 4: IIO_LEVEL_TRIGGER_FIND(int32_t, uint32_t)
+    case 8: IIO_LEVEL_TRIGGER_FIND(int64_t, uint64_t)
+    #undef IIO_LEVEL_TRIGGER_FIND
+    }
+    return n;
+}
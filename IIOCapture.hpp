@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "IIOKernels.hpp"
+
+/*!
+ * IIOSampleFifo queues deinterleaved samples for a set of channels, one
+ * byte array per channel, so that they can be delivered later in chunks of
+ * any size. Sample positions are counted from the last clear().
+ *
+ * Each channel's array is a ring allocated once by reset(), so queueing
+ * and delivering never allocate or move queued samples.
+ */
+class IIOSampleFifo
+{
+private:
+    std::vector<size_t> sizes;
+    std::vector<std::vector<char>> data;
+    size_t capacity;
+    size_t head;
+    size_t count;
+    unsigned long long popped;
+
+    void write(size_t channel, size_t at, const char *in, size_t n);
+    void read(size_t channel, size_t at, char *out, size_t n) const;
+
+public:
+    IIOSampleFifo(void);
+
+    /*!
+     * Empty the fifo, set the size in bytes of one sample of each channel,
+     * and allocate room for capacity samples per channel.
+     */
+    void reset(const std::vector<size_t> &sampleSizes, size_t capacity);
+
+    /*!
+     * Empty the fifo, keeping its channels.
+     */
+    void clear(void);
+
+    /*!
+     * Get the number of samples queued per channel.
+     */
+    size_t size(void) const { return this->count; }
+
+    bool empty(void) const { return this->count == 0; }
+
+    /*!
+     * Get the number of samples that can still be queued per channel.
+     */
+    size_t room(void) const { return this->capacity - this->count; }
+
+    /*!
+     * Get the size in bytes of one sample of the given channel.
+     */
+    size_t sampleSize(size_t channel) const { return this->sizes[channel]; }
+
+    /*!
+     * Get the position of the oldest queued sample.
+     */
+    unsigned long long position(void) const { return this->popped; }
+
+    /*!
+     * Queue samples [offset, offset + n) of one array per channel.
+     * Throws Pothos::RangeException if there isn't room for them.
+     */
+    void append(void *const *inputs, size_t offset, size_t n);
+
+    /*!
+     * Queue queued samples [offset, offset + n) of another fifo with the
+     * same channels.
+     */
+    void append(const IIOSampleFifo &other, size_t offset, size_t n);
+
+    /*!
+     * Move the n oldest samples into one array per channel.
+     */
+    void pop(void *const *outputs, size_t n);
+
+    /*!
+     * Drop the n oldest samples.
+     */
+    void discard(size_t n);
+};
+
+/*!
+ * IIOLevelTrigger finds level crossings in a stream of host format samples
+ * from one channel, carrying its state across chunks.
+ *
+ * A rising edge arms once a sample falls below level - hysteresis, and
+ * fires on the next sample at or above level; a falling edge is the mirror
+ * image. After firing, crossings are ignored for the holdoff. Samples are
+ * scanned in blocks, and a block whose minimum and maximum rule out any
+ * change of state is skipped without a per-sample scan, which keeps sparse
+ * signals cheap.
+ */
+class IIOLevelTrigger
+{
+public:
+    enum Edge
+    {
+        Rising,
+        Falling,
+        Both
+    };
+
+private:
+    size_t length;
+    bool isSigned;
+    double level;
+    Edge edge;
+    double hysteresis;
+    unsigned long long holdoff;
+    bool armedRising;
+    bool armedFalling;
+    unsigned long long holdoffRemaining;
+
+    template <typename T>
+    size_t findType(const T *samples, size_t n);
+
+public:
+    IIOLevelTrigger(void);
+
+    /*!
+     * Watch samples with the given scan element format for crossings of
+     * level, in raw codes. Only single 8, 16, 32 and 64-bit samples are
+     * supported.
+     */
+    IIOLevelTrigger(const IIOScanElement &element, double level, Edge edge = Rising,
+        double hysteresis = 0.0, unsigned long long holdoff = 0);
+
+    /*!
+     * Disarm the trigger, so that a discontinuity in the stream is not
+     * seen as a crossing.
+     */
+    void reset(void);
+
+    /*!
+     * Get the index of the first sample that fires the trigger, or n if
+     * none does. Scanning resumes with the sample after it.
+     */
+    size_t find(const void *samples, size_t n);
+};
@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <map>
+#include <string>
+
+/*!
+ * IIOCommand is an attribute write scheduled at a sample index of a stream.
+ * An empty channel ID refers to a device attribute.
+ */
+struct IIOCommand
+{
+    unsigned long long index;
+    std::string channel;
+    std::string attribute;
+    std::string value;
+};
+
+/*!
+ * IIOCommandQueue orders scheduled attribute writes by sample index, and
+ * decides at which buffer boundary each of them is due.
+ */
+class IIOCommandQueue
+{
+private:
+    std::multimap<unsigned long long, IIOCommand> commands;
+
+public:
+    void push(const IIOCommand &cmd)
+    {
+        this->commands.insert(std::make_pair(cmd.index, cmd));
+    }
+
+    void clear(void)
+    {
+        this->commands.clear();
+    }
+
+    bool empty(void) const
+    {
+        return this->commands.empty();
+    }
+
+    /*!
+     * Get the sample index of the earliest scheduled command.
+     */
+    unsigned long long nextIndex(void) const
+    {
+        return this->commands.begin()->first;
+    }
+
+    /*!
+     * Pop the next command that is due at a buffer boundary, given the sample
+     * index of the boundary and the number of samples until the following
+     * one. A command is due when its index is closer to this boundary than to
+     * the following one, or when it is already late.
+     */
+    bool popDue(unsigned long long boundary, size_t spacing, IIOCommand &cmd)
+    {
+        if (this->commands.empty()) return false;
+        auto it = this->commands.begin();
+        if (it->first >= boundary + (spacing + 1) / 2) return false;
+        cmd = it->second;
+        this->commands.erase(it);
+        return true;
+    }
+};
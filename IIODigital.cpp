@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include "IIODigital.hpp"
+#include <Pothos/Framework.hpp>
+#include <algorithm>
+
+//the number of samples covered by one transition check
+static const size_t edgeBlock = 256;
+
+IIOBitExpander::IIOBitExpander(void) : length(0), mask(0), primed(false), last(0) {}
+
+IIOBitExpander::IIOBitExpander(const IIOScanElement &element, const std::vector<unsigned int> &bits)
+    : length(element.length), bits(bits), mask(0), primed(false), last(0)
+{
+    const bool supported = element.repeat == 1 &&
+        (this->length == 1 || this->length == 2 || this->length == 4 || this->length == 8);
+    if (!supported)
+    {
+        throw Pothos::InvalidArgumentException("IIOBitExpander::IIOBitExpander()", "unsupported channel format");
+    }
+    for (const auto b : bits)
+    {
+        if (b >= this->length * 8)
+        {
+            throw Pothos::RangeException("IIOBitExpander::IIOBitExpander()", "bit out of range: " + std::to_string(b));
+        }
+        this->mask |= uint64_t(1) << b;
+    }
+}
+
+void IIOBitExpander::reset(void)
+{
+    this->primed = false;
+}
+
+template <typename T>
+void IIOBitExpander::expandType(const T *samples, size_t n, uint8_t *const *outputs) const
+{
+    for (size_t k = 0; k < this->bits.size(); ++k)
+    {
+        const unsigned int b = this->bits[k];
+        uint8_t *out = outputs[k];
+        for (size_t i = 0; i < n; ++i) out[i] = uint8_t((samples[i] >> b) & 1);
+    }
+}
+
+template <typename T>
+size_t IIOBitExpander::edgesType(const T *samples, size_t n, unsigned long long index, uint64_t *out)
+{
+    const T mask = T(this->mask);
+    size_t count = 0;
+    size_t i = 0;
+    if (!this->primed && n > 0)
+    {
+        this->last = uint64_t(samples[0] & mask);
+        this->primed = true;
+        out[count++] = index;
+        out[count++] = this->last;
+        i = 1;
+    }
+
+    T last = T(this->last);
+    while (i < n)
+    {
+        const size_t blockEnd = std::min(n, i + edgeBlock);
+
+        //a plain reduction that the compiler can vectorize
+        T changed = 0;
+        for (size_t j = i; j < blockEnd; ++j) changed |= (samples[j] ^ last) & mask;
+        if (changed == 0)
+        {
+            i = blockEnd;
+            continue;
+        }
+
+        for (; i < blockEnd; ++i)
+        {
+            const T value = samples[i] & mask;
+            if (value == last) continue;
+            last = value;
+            out[count++] = index + i;
+            out[count++] = uint64_t(value);
+        }
+    }
+    this->last = uint64_t(last);
+    return count / 2;
+}
+
+void IIOBitExpander::expand(const void *samples, size_t n, uint8_t *const *outputs) const
+{
+    switch (this->length)
+    {
+    case 1: return this->expandType(static_cast<const uint8_t *>(samples), n, outputs);
+    case 2: return this->expandType(static_cast<const uint16_t *>(samples), n, outputs);
+    case 4: return this->expandType(static_cast<const uint32_t *>(samples), n, outputs);
+    case 8: return this->expandType(static_cast<const uint64_t *>(samples), n, outputs);
+    }
+}
+
+size_t IIOBitExpander::edges(const void *samples, size_t n, unsigned long long index, uint64_t *out)
+{
+    switch (this->length)
+    {
+    case 1: return this->edgesType(static_cast<const uint8_t *>(samples), n, index, out);
+    case 2: return this->edgesType(static_cast<const uint16_t *>(samples), n, index, out);
+    case 4: return this->edgesType(static_cast<const uint32_t *>(samples), n, index, out);
+    case 8: return this->edgesType(static_cast<const uint64_t *>(samples), n, index, out);
+    }
+    return 0;
+}
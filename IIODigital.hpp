@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "IIOKernels.hpp"
+
+/*!
+ * IIOBitExpander unpacks chosen bits of one channel's host format samples,
+ * such as the lines of a logic analyzer packed into a wide scan element,
+ * either into one byte per bit per sample, or into a list of the samples
+ * where any of the bits change.
+ *
+ * Both scan samples with plain loops that the compiler can vectorize; edge
+ * detection skips blocks without transitions after a single reduction, so
+ * sparse digital traffic is cheap.
+ */
+class IIOBitExpander
+{
+private:
+    size_t length;
+    std::vector<unsigned int> bits;
+    uint64_t mask;
+    bool primed;
+    uint64_t last;
+
+    template <typename T>
+    void expandType(const T *samples, size_t n, uint8_t *const *outputs) const;
+    template <typename T>
+    size_t edgesType(const T *samples, size_t n, unsigned long long index, uint64_t *out);
+
+public:
+    IIOBitExpander(void);
+
+    /*!
+     * Unpack the given bits of samples with the given scan element format.
+     * Only single 8, 16, 32 and 64-bit samples are supported.
+     */
+    IIOBitExpander(const IIOScanElement &element, const std::vector<unsigned int> &bits);
+
+    /*!
+     * Write each chosen bit of n samples, as 0 or 1, to one output array
+     * per bit, in the order the bits were given.
+     */
+    void expand(const void *samples, size_t n, uint8_t *const *outputs) const;
+
+    /*!
+     * Write an {index, value} pair for every sample whose chosen bits differ
+     * from the previous sample's, and for the first sample after a reset,
+     * where index counts from the first sample's index and value holds the
+     * chosen bits in place. Returns the number of pairs written, at most n.
+     */
+    size_t edges(const void *samples, size_t n, unsigned long long index, uint64_t *out);
+
+    /*!
+     * Forget the previous sample, so that the next one is an edge.
+     */
+    void reset(void);
+};
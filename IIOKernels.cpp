@@ -0,0 +1,318 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include "IIOKernels.hpp"
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/***********************************************************************
+ * Sample conversion helpers
+ **********************************************************************/
+static bool isHostBigEndian(void)
+{
+    const uint16_t probe = 0x0100;
+    return *reinterpret_cast<const uint8_t *>(&probe) == 0x01;
+}
+
+template <typename U>
+static inline U byteSwap(U v)
+{
+    U r = 0;
+    for (size_t i = 0; i < sizeof(U); ++i)
+    {
+        r = U((r << 8) | (v & 0xff));
+        v = U(v >> 8);
+    }
+    return r;
+}
+
+template <>
+inline uint8_t byteSwap<uint8_t>(uint8_t v)
+{
+    return v;
+}
+
+//Equivalent to iio_channel_convert() for a single non-repeated sample
+template <typename U>
+static inline U convertSample(U raw, const IIOScanElement &e)
+{
+    typedef typename std::make_signed<U>::type S;
+    if (e.swap) raw = byteSwap(raw);
+    raw = U(raw >> e.shift);
+    if (!e.fullyDefined && e.bits < sizeof(U) * 8)
+    {
+        const unsigned int drop = sizeof(U) * 8 - e.bits;
+        if (e.isSigned) raw = U(S(S(raw << drop) >> drop));
+        else raw = U(raw & (U(~U(0)) >> drop));
+    }
+    return raw;
+}
+
+//Equivalent to iio_channel_convert_inverse() for a single non-repeated sample
+template <typename U>
+static inline U convertSampleInverse(U val, const IIOScanElement &e)
+{
+    if (e.bits < sizeof(U) * 8) val = U(val & (U(~U(0)) >> (sizeof(U) * 8 - e.bits)));
+    val = U(val << e.shift);
+    if (e.swap) val = byteSwap(val);
+    return val;
+}
+
+/***********************************************************************
+ * Scan layout
+ **********************************************************************/
+bool IIOScanElement::isPlain(void) const
+{
+    return this->repeat == 1 && !this->swap && this->shift == 0 &&
+        (this->fullyDefined || this->bits == this->length * 8);
+}
+
+IIOScanLayout::IIOScanLayout(void) : step(0) {}
+
+IIOScanLayout::IIOScanLayout(IIOBuffer &buffer, const std::vector<IIOChannel> &channels)
+    : channels(channels), step(buffer.step())
+{
+    const bool hostBigEndian = isHostBigEndian();
+    auto start = static_cast<char *>(buffer.start());
+    for (auto c : this->channels)
+    {
+        const auto format = c.dataFormat();
+        IIOScanElement e;
+        e.offset = static_cast<char *>(buffer.first(c)) - start;
+        e.length = format.length / 8;
+        e.repeat = format.repeat ? format.repeat : 1;
+        e.bits = format.bits;
+        e.shift = format.shift;
+        e.isSigned = format.is_signed;
+        e.fullyDefined = format.is_fully_defined;
+        e.swap = e.length > 1 && format.is_be != hostBigEndian;
+        this->elements.push_back(e);
+    }
+}
+
+IIOScanLayout::IIOScanLayout(const std::vector<IIOScanElement> &elements, ptrdiff_t step)
+    : elements(elements), step(step) {}
+
+bool IIOScanLayout::isPacked(size_t sampleSize) const
+{
+    for (size_t i = 0; i < this->elements.size(); ++i)
+    {
+        const auto &e = this->elements[i];
+        if (e.length != sampleSize || e.repeat != 1) return false;
+        if (e.offset != ptrdiff_t(i * sampleSize)) return false;
+    }
+    return this->step == ptrdiff_t(this->elements.size() * sampleSize);
+}
+
+bool IIOScanLayout::isPlain(void) const
+{
+    for (const auto &e : this->elements)
+    {
+        if (!e.isPlain()) return false;
+    }
+    return true;
+}
+
+/***********************************************************************
+ * Deinterleave kernels
+ **********************************************************************/
+
+//Runtime-stride kernel: any layout, one channel at a time
+static void deinterleaveGeneric(const IIODeinterleaver &self, const char *src, void *const *outputs, size_t count)
+{
+    const auto &elements = self.layout();
+    const ptrdiff_t step = self.scanStep();
+    for (size_t n = 0; n < elements.size(); ++n)
+    {
+        const auto &e = elements[n];
+        const char *in = src + e.offset;
+        switch (e.repeat == 1 ? e.length : 0)
+        {
+        #define IIO_DEINTERLEAVE_GENERIC(U) { \
+            auto out = static_cast<U *>(outputs[n]); \
+            for (size_t i = 0; i < count; ++i, in += step) { \
+                U raw; std::memcpy(&raw, in, sizeof(U)); \
+                out[i] = convertSample(raw, e); \
+            } } break;
+        case 1: IIO_DEINTERLEAVE_GENERIC(uint8_t)
+        case 2: IIO_DEINTERLEAVE_GENERIC(uint16_t)
+        case 4: IIO_DEINTERLEAVE_GENERIC(uint32_t)
+        case 8: IIO_DEINTERLEAVE_GENERIC(uint64_t)
+        #undef IIO_DEINTERLEAVE_GENERIC
+        default:
+        {
+            //odd sample sizes and repeated samples go through libiio
+            auto chn = self.channel(n);
+            auto out = static_cast<char *>(outputs[n]);
+            const size_t outStep = e.length * e.repeat;
+            for (size_t i = 0; i < count; ++i, in += step, out += outStep)
+            {
+                chn.convert(out, in);
+            }
+        }
+        }
+    }
+}
+
+//Fixed-layout kernel: N packed channels of type U, known at compile time
+template <typename U, size_t N, bool Plain>
+static void deinterleaveFixed(const IIODeinterleaver &self, const char *src, void *const *outputs, size_t count)
+{
+    const auto &elements = self.layout();
+    const U *in = reinterpret_cast<const U *>(src);
+    for (size_t n = 0; n < N; ++n)
+    {
+        U *out = static_cast<U *>(outputs[n]);
+        if (Plain)
+        {
+            for (size_t i = 0; i < count; ++i) out[i] = in[i * N + n];
+        }
+        else
+        {
+            const IIOScanElement e = elements[n];
+            for (size_t i = 0; i < count; ++i) out[i] = convertSample(in[i * N + n], e);
+        }
+    }
+}
+
+IIODeinterleaver::IIODeinterleaver(void) : kernel(nullptr) {}
+
+IIODeinterleaver::IIODeinterleaver(IIOBuffer &buffer, const std::vector<IIOChannel> &channels)
+    : IIOScanLayout(buffer, channels), kernel(&deinterleaveGeneric), kernelName("generic")
+{
+    this->selectKernel();
+}
+
+IIODeinterleaver::IIODeinterleaver(const std::vector<IIOScanElement> &elements, ptrdiff_t step, bool specialize)
+    : IIOScanLayout(elements, step), kernel(&deinterleaveGeneric), kernelName("generic")
+{
+    if (specialize) this->selectKernel();
+}
+
+void IIODeinterleaver::selectKernel(void)
+{
+    const bool plain = this->isPlain();
+    #define IIO_SELECT_DEINTERLEAVE(U, N, desc) \
+        if (this->elements.size() == N && this->isPacked(sizeof(U))) { \
+            this->kernel = plain ? &deinterleaveFixed<U, N, true> : &deinterleaveFixed<U, N, false>; \
+            this->kernelName = std::string(desc) + (plain ? "" : " converted"); \
+            return; \
+        }
+    IIO_SELECT_DEINTERLEAVE(uint16_t, 2, "2x16-bit")
+    IIO_SELECT_DEINTERLEAVE(uint16_t, 4, "4x16-bit")
+    IIO_SELECT_DEINTERLEAVE(uint16_t, 8, "8x16-bit")
+    IIO_SELECT_DEINTERLEAVE(uint32_t, 1, "1x32-bit")
+    #undef IIO_SELECT_DEINTERLEAVE
+}
+
+void IIODeinterleaver::operator()(const void *src, void *const *outputs, size_t count) const
+{
+    this->kernel(*this, static_cast<const char *>(src), outputs, count);
+}
+
+const std::string &IIODeinterleaver::name(void) const
+{
+    return this->kernelName;
+}
+
+/***********************************************************************
+ * Interleave kernels
+ **********************************************************************/
+
+//Runtime-stride kernel: any layout, one channel at a time
+static void interleaveGeneric(const IIOInterleaver &self, void *const *inputs, char *dst, size_t count)
+{
+    const auto &elements = self.layout();
+    const ptrdiff_t step = self.scanStep();
+    for (size_t n = 0; n < elements.size(); ++n)
+    {
+        const auto &e = elements[n];
+        char *out = dst + e.offset;
+        switch (e.repeat == 1 ? e.length : 0)
+        {
+        #define IIO_INTERLEAVE_GENERIC(U) { \
+            auto in = static_cast<const U *>(inputs[n]); \
+            for (size_t i = 0; i < count; ++i, out += step) { \
+                const U raw = convertSampleInverse(in[i], e); \
+                std::memcpy(out, &raw, sizeof(U)); \
+            } } break;
+        case 1: IIO_INTERLEAVE_GENERIC(uint8_t)
+        case 2: IIO_INTERLEAVE_GENERIC(uint16_t)
+        case 4: IIO_INTERLEAVE_GENERIC(uint32_t)
+        case 8: IIO_INTERLEAVE_GENERIC(uint64_t)
+        #undef IIO_INTERLEAVE_GENERIC
+        default:
+        {
+            //odd sample sizes and repeated samples go through libiio
+            auto chn = self.channel(n);
+            auto in = static_cast<const char *>(inputs[n]);
+            const size_t inStep = e.length * e.repeat;
+            for (size_t i = 0; i < count; ++i, out += step, in += inStep)
+            {
+                chn.convertInverse(out, in);
+            }
+        }
+        }
+    }
+}
+
+//Fixed-layout kernel: N packed channels of type U, known at compile time
+template <typename U, size_t N, bool Plain>
+static void interleaveFixed(const IIOInterleaver &self, void *const *inputs, char *dst, size_t count)
+{
+    const auto &elements = self.layout();
+    U *out = reinterpret_cast<U *>(dst);
+    for (size_t n = 0; n < N; ++n)
+    {
+        const U *in = static_cast<const U *>(inputs[n]);
+        if (Plain)
+        {
+            for (size_t i = 0; i < count; ++i) out[i * N + n] = in[i];
+        }
+        else
+        {
+            const IIOScanElement e = elements[n];
+            for (size_t i = 0; i < count; ++i) out[i * N + n] = convertSampleInverse(in[i], e);
+        }
+    }
+}
+
+IIOInterleaver::IIOInterleaver(void) : kernel(nullptr) {}
+
+IIOInterleaver::IIOInterleaver(IIOBuffer &buffer, const std::vector<IIOChannel> &channels)
+    : IIOScanLayout(buffer, channels), kernel(&interleaveGeneric), kernelName("generic")
+{
+    this->selectKernel();
+}
+
+IIOInterleaver::IIOInterleaver(const std::vector<IIOScanElement> &elements, ptrdiff_t step, bool specialize)
+    : IIOScanLayout(elements, step), kernel(&interleaveGeneric), kernelName("generic")
+{
+    if (specialize) this->selectKernel();
+}
+
+void IIOInterleaver::selectKernel(void)
+{
+    const bool plain = this->isPlain();
+    #define IIO_SELECT_INTERLEAVE(U, N, desc) \
+        if (this->elements.size() == N && this->isPacked(sizeof(U))) { \
+            this->kernel = plain ? &interleaveFixed<U, N, true> : &interleaveFixed<U, N, false>; \
+            this->kernelName = std::string(desc) + (plain ? "" : " converted"); \
+            return; \
+        }
+    IIO_SELECT_INTERLEAVE(uint16_t, 2, "2x16-bit")
+    IIO_SELECT_INTERLEAVE(uint16_t, 4, "4x16-bit")
+    IIO_SELECT_INTERLEAVE(uint16_t, 8, "8x16-bit")
+    IIO_SELECT_INTERLEAVE(uint32_t, 1, "1x32-bit")
+    #undef IIO_SELECT_INTERLEAVE
+}
+
+void IIOInterleaver::operator()(void *const *inputs, void *dst, size_t count) const
+{
+    this->kernel(*this, inputs, static_cast<char *>(dst), count);
+}
+
+const std::string &IIOInterleaver::name(void) const
+{
+    return this->kernelName;
+}
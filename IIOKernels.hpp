@@ -0,0 +1,180 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "IIOSupport.hpp"
+
+/*!
+ * IIOScanElement describes where one channel's samples live within a scan
+ * of an IIOBuffer, and how its raw samples convert to the host format.
+ */
+struct IIOScanElement
+{
+    ptrdiff_t offset;
+    unsigned int length;
+    unsigned int repeat;
+    unsigned int bits;
+    unsigned int shift;
+    bool isSigned;
+    bool fullyDefined;
+    bool swap;
+
+    /*!
+     * Check if raw samples of this element are already in host format.
+     */
+    bool isPlain(void) const;
+};
+
+/*!
+ * IIOScanLayout describes the layout of a set of channels within the scans
+ * of an IIOBuffer.
+ */
+class IIOScanLayout
+{
+protected:
+    std::vector<IIOChannel> channels;
+    std::vector<IIOScanElement> elements;
+    ptrdiff_t step;
+
+public:
+    IIOScanLayout(void);
+
+    /*!
+     * Compute the layout of the given scan element channels in a buffer.
+     * The buffer must have been created with these channels enabled.
+     */
+    IIOScanLayout(IIOBuffer &buffer, const std::vector<IIOChannel> &channels);
+
+    /*!
+     * Describe a layout directly, without channels or a buffer, such as for
+     * benchmarks. Elements that need libiio's conversion aren't supported.
+     */
+    IIOScanLayout(const std::vector<IIOScanElement> &elements, ptrdiff_t step);
+
+    /*!
+     * Check if the channels are packed back to back, in order, with the
+     * given sample size, filling every scan exactly.
+     */
+    bool isPacked(size_t sampleSize) const;
+
+    /*!
+     * Check if every channel's raw samples are already in host format.
+     */
+    bool isPlain(void) const;
+};
+
+/*!
+ * IIODeinterleaver converts scans from an input IIOBuffer into one
+ * contiguous host-format array per channel.
+ *
+ * The kernel is chosen once from the channel layout. Common layouts
+ * (2, 4 or 8 packed 16-bit channels, or a single 32-bit channel) use
+ * kernels with the channel count and stride fixed at compile time, and
+ * everything else falls back on a runtime-stride kernel.
+ */
+class IIODeinterleaver : public IIOScanLayout
+{
+public:
+    typedef void (*Kernel)(const IIODeinterleaver &, const char *, void *const *, size_t);
+
+    IIODeinterleaver(void);
+    IIODeinterleaver(IIOBuffer &buffer, const std::vector<IIOChannel> &channels);
+
+    /*!
+     * Deinterleave a layout given directly. Without specialize, the
+     * runtime-stride kernel is used for every layout, for comparisons.
+     */
+    IIODeinterleaver(const std::vector<IIOScanElement> &elements, ptrdiff_t step, bool specialize = true);
+
+    /*!
+     * Deinterleave count scans starting at src into one output array per
+     * channel, in the order the channels were given.
+     */
+    void operator()(const void *src, void *const *outputs, size_t count) const;
+
+    /*!
+     * Get a short description of the selected kernel.
+     */
+    const std::string &name(void) const;
+
+    const std::vector<IIOScanElement> &layout(void) const { return this->elements; }
+    ptrdiff_t scanStep(void) const { return this->step; }
+    IIOChannel channel(size_t i) const { return this->channels[i]; }
+
+private:
+    Kernel kernel;
+    std::string kernelName;
+
+    void selectKernel(void);
+};
+
+/*!
+ * IIODeinterleaveRange is one range of scans deinterleaved on a worker
+ * pool, with an output pointer per channel.
+ */
+struct IIODeinterleaveRange
+{
+    const IIODeinterleaver *deinterleaver;
+    const char *scans;
+    std::vector<void *> outputs;
+    size_t count;
+};
+
+/*!
+ * IIODeinterleaveJob runs the deinterleaver over its range. It only points
+ * at the range, so that it fits in std::function without an allocation,
+ * and can be built once and reused as the range is rewritten.
+ */
+struct IIODeinterleaveJob
+{
+    IIODeinterleaveRange *range;
+
+    void operator()(void) const
+    {
+        const auto &r = *this->range;
+        if (r.count != 0) (*r.deinterleaver)(r.scans, r.outputs.data(), r.count);
+    }
+};
+
+/*!
+ * IIOInterleaver converts one contiguous host-format array per channel into
+ * scans of an output IIOBuffer. It is the inverse of IIODeinterleaver, and
+ * selects kernels for the same common layouts.
+ */
+class IIOInterleaver : public IIOScanLayout
+{
+public:
+    typedef void (*Kernel)(const IIOInterleaver &, void *const *, char *, size_t);
+
+    IIOInterleaver(void);
+    IIOInterleaver(IIOBuffer &buffer, const std::vector<IIOChannel> &channels);
+
+    /*!
+     * Interleave a layout given directly. Without specialize, the
+     * runtime-stride kernel is used for every layout, for comparisons.
+     */
+    IIOInterleaver(const std::vector<IIOScanElement> &elements, ptrdiff_t step, bool specialize = true);
+
+    /*!
+     * Interleave count samples from each input array into scans starting at
+     * dst, in the order the channels were given.
+     */
+    void operator()(void *const *inputs, void *dst, size_t count) const;
+
+    /*!
+     * Get a short description of the selected kernel.
+     */
+    const std::string &name(void) const;
+
+    const std::vector<IIOScanElement> &layout(void) const { return this->elements; }
+    ptrdiff_t scanStep(void) const { return this->step; }
+    IIOChannel channel(size_t i) const { return this->channels[i]; }
+
+private:
+    Kernel kernel;
+    std::string kernelName;
+
+    void selectKernel(void);
+};
@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "IIOKernels.hpp"
+#include "IIOWorkerPool.hpp"
+
+/***********************************************************************
+ * Compares the layout-specialized deinterleave and interleave kernels
+ * with the runtime-stride kernel on buffers held in memory, so that no
+ * IIO device is needed, then sweeps the thread count of the parallel
+ * deinterleave on a large buffer, up to the core count or the thread
+ * count given as the first argument. Built with ENABLE_IIO_BENCHMARKS.
+ **********************************************************************/
+
+//the number of scans per pass, and the passes timed per kernel
+static const size_t benchScans = 1 << 16;
+static const size_t benchPasses = 200;
+
+//the scans per pass of the thread sweep, large enough to leave the cache
+static const size_t sweepScans = 1 << 21;
+static const size_t sweepPasses = 20;
+
+static std::vector<IIOScanElement> packedLayout(const size_t channels, const unsigned int length, const bool plain)
+{
+    std::vector<IIOScanElement> elements;
+    for (size_t n = 0; n < channels; ++n)
+    {
+        IIOScanElement e;
+        e.offset = ptrdiff_t(n * length);
+        e.length = length;
+        e.repeat = 1;
+        e.bits = plain ? length * 8 : length * 8 - 4;
+        e.shift = plain ? 0 : 4;
+        e.isSigned = true;
+        e.fullyDefined = plain;
+        e.swap = false;
+        elements.push_back(e);
+    }
+    return elements;
+}
+
+template <typename Fcn>
+static double nsPerScan(const Fcn &fcn)
+{
+    fcn();
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < benchPasses; ++i) fcn();
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (benchPasses * benchScans);
+}
+
+static void benchLayout(const size_t channels, const unsigned int length, const bool plain)
+{
+    const auto elements = packedLayout(channels, length, plain);
+    const ptrdiff_t step = ptrdiff_t(channels * length);
+    std::vector<char> scans(benchScans * step, 1);
+    std::vector<std::vector<char>> arrays(channels, std::vector<char>(benchScans * length, 1));
+    std::vector<void *> ptrs;
+    for (auto &a : arrays) ptrs.push_back(a.data());
+
+    const IIODeinterleaver generic(elements, step, false), fixed(elements, step);
+    const IIOInterleaver genericInverse(elements, step, false), fixedInverse(elements, step);
+    const double d0 = nsPerScan([&]{ generic(scans.data(), ptrs.data(), benchScans); });
+    const double d1 = nsPerScan([&]{ fixed(scans.data(), ptrs.data(), benchScans); });
+    const double i0 = nsPerScan([&]{ genericInverse(ptrs.data(), scans.data(), benchScans); });
+    const double i1 = nsPerScan([&]{ fixedInverse(ptrs.data(), scans.data(), benchScans); });
+
+    std::printf("%-22s deinterleave %6.2f -> %6.2f ns/scan (%4.1fx)  interleave %6.2f -> %6.2f ns/scan (%4.1fx)\n",
+        fixed.name().c_str(), d0, d1, d0 / d1, i0, i1, i0 / i1);
+}
+
+static void benchThreads(const size_t channels, const unsigned int length, const size_t maxThreads)
+{
+    const auto elements = packedLayout(channels, length, true);
+    const ptrdiff_t step = ptrdiff_t(channels * length);
+    std::vector<char> scans(sweepScans * step, 1);
+    std::vector<std::vector<char>> arrays(channels, std::vector<char>(sweepScans * length, 1));
+    const IIODeinterleaver deinterleaver(elements, step);
+
+    //split the buffer the way IIOSource does, one range per thread
+    double base = 0.0;
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        std::vector<IIODeinterleaveRange> ranges(threads);
+        std::vector<std::function<void(void)>> jobs;
+        const size_t rangeSize = (sweepScans + threads - 1) / threads;
+        for (size_t r = 0; r < threads; ++r)
+        {
+            const size_t begin = std::min(r * rangeSize, sweepScans);
+            ranges[r].deinterleaver = &deinterleaver;
+            ranges[r].scans = scans.data() + begin * step;
+            ranges[r].count = std::min(rangeSize, sweepScans - begin);
+            for (auto &a : arrays) ranges[r].outputs.push_back(a.data() + begin * length);
+            jobs.push_back(IIODeinterleaveJob{&ranges[r]});
+        }
+        std::unique_ptr<IIOWorkerPool> pool(threads > 1 ? new IIOWorkerPool(threads - 1) : nullptr);
+        const auto pass = [&]{ if (pool) pool->run(jobs); else jobs.front()(); };
+
+        pass();
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < sweepPasses; ++i) pass();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        const double rate = sweepPasses * sweepScans / elapsed.count() / 1e6;
+        if (threads == 1) base = rate;
+        std::printf("%-22s %2zu threads %8.1f Mscans/s (%4.2fx)\n", deinterleaver.name().c_str(), threads, rate, rate / base);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const size_t maxThreads = argc > 1 ? std::strtoul(argv[1], nullptr, 10) :
+        std::max<size_t>(std::thread::hardware_concurrency(), 1);
+
+    for (const bool plain : {true, false})
+    {
+        benchLayout(2, 2, plain);
+        benchLayout(4, 2, plain);
+        benchLayout(8, 2, plain);
+        benchLayout(1, 4, plain);
+    }
+    benchThreads(4, 2, maxThreads);
+    benchThreads(8, 2, maxThreads);
+    return 0;
+}
@@ -0,0 +1,304 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include "IIOMonitor.hpp"
+#include <Pothos/Framework.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+/***********************************************************************
+ * Channel statistics
+ **********************************************************************/
+IIOChannelStats::IIOChannelStats(void)
+    : length(0), isSigned(false), fullScaleLow(0), fullScaleHigh(0)
+{
+    this->reset();
+}
+
+IIOChannelStats::IIOChannelStats(const IIOScanElement &element)
+    : length(element.length), isSigned(element.isSigned)
+{
+    if (!supports(element))
+    {
+        throw Pothos::InvalidArgumentException("IIOChannelStats::IIOChannelStats()", "unsupported channel format");
+    }
+
+    //the full-scale codes of the significant bits
+    const unsigned int bits = std::min<unsigned int>(element.bits ? element.bits : element.length * 8, 63);
+    this->fullScaleLow = this->isSigned ? -(int64_t(1) << (bits - 1)) : 0;
+    this->fullScaleHigh = this->isSigned ? (int64_t(1) << (bits - 1)) - 1 : (int64_t(1) << bits) - 1;
+    this->reset();
+}
+
+bool IIOChannelStats::supports(const IIOScanElement &element)
+{
+    return element.repeat == 1 &&
+        (element.length == 1 || element.length == 2 || element.length == 4 || element.length == 8);
+}
+
+void IIOChannelStats::reset(void)
+{
+    this->count = 0;
+    this->min = std::numeric_limits<int64_t>::max();
+    this->max = std::numeric_limits<int64_t>::min();
+    this->sum = 0.0;
+    this->sumSquares = 0.0;
+    this->clipped = 0;
+}
+
+//the number of samples reduced in integers before folding into doubles
+static const size_t statsBlock = 1024;
+
+template <typename T>
+void IIOChannelStats::accumulateType(const T *samples, size_t n)
+{
+    const int64_t low = this->fullScaleLow, high = this->fullScaleHigh;
+    for (size_t i = 0; i < n; i += statsBlock)
+    {
+        const size_t end = std::min(n, i + statsBlock);
+
+        //plain reductions that the compiler can vectorize; squares of 32-bit
+        //and wider samples don't fit integer accumulators
+        T lo = samples[i], hi = samples[i];
+        int64_t sum = 0;
+        uint64_t clipped = 0;
+        double sumSquares = 0.0;
+        for (size_t j = i; j < end; ++j)
+        {
+            const T x = samples[j];
+            lo = std::min(lo, x);
+            hi = std::max(hi, x);
+            sum += int64_t(x);
+            clipped += uint64_t(int64_t(x) <= low) + uint64_t(int64_t(x) >= high);
+        }
+        if (sizeof(T) <= 2)
+        {
+            int64_t squares = 0;
+            for (size_t j = i; j < end; ++j) squares += int64_t(samples[j]) * int64_t(samples[j]);
+            sumSquares = double(squares);
+        }
+        else
+        {
+            for (size_t j = i; j < end; ++j) sumSquares += double(samples[j]) * double(samples[j]);
+        }
+
+        this->min = std::min(this->min, int64_t(lo));
+        this->max = std::max(this->max, int64_t(hi));
+        this->sum += double(sum);
+        this->sumSquares += sumSquares;
+        this->clipped += clipped;
+    }
+    this->count += n;
+}
+
+void IIOChannelStats::accumulate(const void *samples, size_t n)
+{
+    if (n == 0) return;
+    switch (this->length)
+    {
+    #define IIO_STATS_ACCUMULATE(S, U) \
+        if (this->isSigned) this->accumulateType(static_cast<const S *>(samples), n); \
+        else this->accumulateType(static_cast<const U *>(samples), n); \
+        break;
+    case 1: IIO_STATS_ACCUMULATE(int8_t, uint8_t)
+    case 2: IIO_STATS_ACCUMULATE(int16_t, uint16_t)
+    case 4: IIO_STATS_ACCUMULATE(int32_t, uint32_t)
+    case 8: IIO_STATS_ACCUMULATE(int64_t, uint64_t)
+    #undef IIO_STATS_ACCUMULATE
+    }
+}
+
+IIOChannelStats::Summary IIOChannelStats::summary(void) const
+{
+    Summary s;
+    s.count = this->count;
+    s.min = this->count ? double(this->min) : 0.0;
+    s.max = this->count ? double(this->max) : 0.0;
+    s.mean = this->count ? this->sum / this->count : 0.0;
+    s.rms = this->count ? std::sqrt(this->sumSquares / this->count) : 0.0;
+    s.clipped = this->clipped;
+    return s;
+}
+
+/***********************************************************************
+ * Min/max envelope
+ **********************************************************************/
+IIOEnvelope::IIOEnvelope(void)
+    : length(0), isSigned(false), decimation(1), binCount(0), binMin(0), binMax(0) {}
+
+IIOEnvelope::IIOEnvelope(const IIOScanElement &element, size_t decimation)
+    : length(element.length), isSigned(element.isSigned), decimation(decimation), binCount(0), binMin(0), binMax(0)
+{
+    if (!IIOChannelStats::supports(element))
+    {
+        throw Pothos::InvalidArgumentException("IIOEnvelope::IIOEnvelope()", "unsupported channel format");
+    }
+    if (decimation == 0)
+    {
+        throw Pothos::RangeException("IIOEnvelope::IIOEnvelope()", "decimation must be at least 1");
+    }
+}
+
+void IIOEnvelope::reset(void)
+{
+    this->binCount = 0;
+}
+
+template <typename T>
+void IIOEnvelope::accumulateType(const T *samples, size_t n, std::vector<char> &points)
+{
+    size_t i = 0;
+    while (i < n)
+    {
+        const size_t end = i + std::min(n - i, this->decimation - this->binCount);
+
+        //a plain reduction that the compiler can vectorize
+        T lo = samples[i], hi = samples[i];
+        if (this->binCount != 0)
+        {
+            std::memcpy(&lo, &this->binMin, sizeof(T));
+            std::memcpy(&hi, &this->binMax, sizeof(T));
+        }
+        for (size_t j = i; j < end; ++j)
+        {
+            lo = std::min(lo, samples[j]);
+            hi = std::max(hi, samples[j]);
+        }
+        this->binCount += end - i;
+        i = end;
+
+        //a completed run becomes a point, a partial one waits for more
+        if (this->binCount == this->decimation)
+        {
+            const T point[2] = {lo, hi};
+            const auto bytes = reinterpret_cast<const char *>(point);
+            points.insert(points.end(), bytes, bytes + sizeof(point));
+            this->binCount = 0;
+        }
+        else
+        {
+            std::memcpy(&this->binMin, &lo, sizeof(T));
+            std::memcpy(&this->binMax, &hi, sizeof(T));
+        }
+    }
+}
+
+void IIOEnvelope::accumulate(const void *samples, size_t n, std::vector<char> &points)
+{
+    switch (this->length)
+    {
+    #define IIO_ENVELOPE_ACCUMULATE(S, U) \
+        if (this->isSigned) this->accumulateType(static_cast<const S *>(samples), n, points); \
+        else this->accumulateType(static_cast<const U *>(samples), n, points); \
+        break;
+    case 1: IIO_ENVELOPE_ACCUMULATE(int8_t, uint8_t)
+    case 2: IIO_ENVELOPE_ACCUMULATE(int16_t, uint16_t)
+    case 4: IIO_ENVELOPE_ACCUMULATE(int32_t, uint32_t)
+    case 8: IIO_ENVELOPE_ACCUMULATE(int64_t, uint64_t)
+    #undef IIO_ENVELOPE_ACCUMULATE
+    }
+}
+
+/***********************************************************************
+ * Code histogram
+ **********************************************************************/
+//the number of interleaved sub-histograms
+static const size_t histogramWays = 4;
+
+//the widest histogram, in bits
+static const unsigned int histogramBits = 16;
+
+IIOCodeHistogram::IIOCodeHistogram(void)
+    : length(0), isSigned(false), firstCode(0), binShift(0), binCount(0), pending(0) {}
+
+IIOCodeHistogram::IIOCodeHistogram(const IIOScanElement &element)
+    : length(element.length), isSigned(element.isSigned), pending(0)
+{
+    if (!IIOChannelStats::supports(element))
+    {
+        throw Pothos::InvalidArgumentException("IIOCodeHistogram::IIOCodeHistogram()", "unsupported channel format");
+    }
+
+    const unsigned int bits = std::min<unsigned int>(element.bits ? element.bits : element.length * 8, 63);
+    this->firstCode = this->isSigned ? -(int64_t(1) << (bits - 1)) : 0;
+    this->binShift = bits > histogramBits ? bits - histogramBits : 0;
+    this->binCount = size_t(1) << (bits - this->binShift);
+    this->subCounts.assign(histogramWays * this->binCount, 0);
+    this->totals.assign(this->binCount, 0);
+}
+
+void IIOCodeHistogram::reset(void)
+{
+    std::fill(this->subCounts.begin(), this->subCounts.end(), 0);
+    std::fill(this->totals.begin(), this->totals.end(), 0);
+    this->pending = 0;
+}
+
+void IIOCodeHistogram::fold(void)
+{
+    for (size_t w = 0; w < histogramWays; ++w)
+    {
+        auto sub = this->subCounts.data() + w * this->binCount;
+        for (size_t b = 0; b < this->binCount; ++b) this->totals[b] += sub[b];
+    }
+    std::fill(this->subCounts.begin(), this->subCounts.end(), 0);
+    this->pending = 0;
+}
+
+template <typename T>
+void IIOCodeHistogram::accumulateType(const T *samples, size_t n)
+{
+    //codes outside the significant bits are wrapped rather than trusted
+    const uint64_t first = uint64_t(this->firstCode);
+    const unsigned int shift = this->binShift;
+    const uint64_t mask = this->binCount - 1;
+    const auto bin = [first, shift, mask](const T x) { return size_t(((uint64_t(int64_t(x)) - first) >> shift) & mask); };
+
+    uint32_t *sub0 = this->subCounts.data();
+    uint32_t *sub1 = sub0 + this->binCount;
+    uint32_t *sub2 = sub1 + this->binCount;
+    uint32_t *sub3 = sub2 + this->binCount;
+    size_t i = 0;
+    for (; i + histogramWays <= n; i += histogramWays)
+    {
+        sub0[bin(samples[i])]++;
+        sub1[bin(samples[i + 1])]++;
+        sub2[bin(samples[i + 2])]++;
+        sub3[bin(samples[i + 3])]++;
+    }
+    for (; i < n; ++i) sub0[bin(samples[i])]++;
+}
+
+void IIOCodeHistogram::accumulate(const void *samples, size_t n)
+{
+    if (n == 0) return;
+
+    //fold the 32-bit sub-histograms into the totals before they can overflow
+    if (this->pending + n > std::numeric_limits<uint32_t>::max()) this->fold();
+    this->pending += n;
+
+    switch (this->length)
+    {
+    #define IIO_HISTOGRAM_ACCUMULATE(S, U) \
+        if (this->isSigned) this->accumulateType(static_cast<const S *>(samples), n); \
+        else this->accumulateType(static_cast<const U *>(samples), n); \
+        break;
+    case 1: IIO_HISTOGRAM_ACCUMULATE(int8_t, uint8_t)
+    case 2: IIO_HISTOGRAM_ACCUMULATE(int16_t, uint16_t)
+    case 4: IIO_HISTOGRAM_ACCUMULATE(int32_t, uint32_t)
+    case 8: IIO_HISTOGRAM_ACCUMULATE(int64_t, uint64_t)
+    #undef IIO_HISTOGRAM_ACCUMULATE
+    }
+}
+
+std::vector<unsigned long long> IIOCodeHistogram::counts(void) const
+{
+    auto merged = this->totals;
+    for (size_t w = 0; w < histogramWays; ++w)
+    {
+        auto sub = this->subCounts.data() + w * this->binCount;
+        for (size_t b = 0; b < this->binCount; ++b) merged[b] += sub[b];
+    }
+    return merged;
+}
@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "IIOKernels.hpp"
+
+/*!
+ * IIOChannelStats accumulates the minimum, maximum, mean, RMS and number of
+ * full-scale samples of one channel's host format samples, in raw codes.
+ *
+ * Samples are reduced in integer arithmetic with one plain loop per sample
+ * type, which the compiler can vectorize.
+ */
+class IIOChannelStats
+{
+public:
+    /*!
+     * A snapshot of the accumulated statistics.
+     */
+    struct Summary
+    {
+        unsigned long long count;
+        double min;
+        double max;
+        double mean;
+        double rms;
+        unsigned long long clipped;
+    };
+
+private:
+    size_t length;
+    bool isSigned;
+    int64_t fullScaleLow;
+    int64_t fullScaleHigh;
+    unsigned long long count;
+    int64_t min;
+    int64_t max;
+    double sum;
+    double sumSquares;
+    unsigned long long clipped;
+
+    template <typename T>
+    void accumulateType(const T *samples, size_t n);
+
+public:
+    IIOChannelStats(void);
+
+    /*!
+     * Accumulate samples with the given scan element format. Only single 8,
+     * 16, 32 and 64-bit samples are supported; check with supports().
+     */
+    IIOChannelStats(const IIOScanElement &element);
+
+    static bool supports(const IIOScanElement &element);
+
+    /*!
+     * Add n samples to the statistics.
+     */
+    void accumulate(const void *samples, size_t n);
+
+    /*!
+     * Get the statistics accumulated since the last reset.
+     */
+    Summary summary(void) const;
+
+    void reset(void);
+};
+
+/*!
+ * IIOEnvelope reduces one channel's host format samples to the minimum and
+ * maximum of every run of decimation samples, carrying a partial run across
+ * chunks. Each point is a pair of samples in the channel's own type, the
+ * minimum first.
+ */
+class IIOEnvelope
+{
+private:
+    size_t length;
+    bool isSigned;
+    size_t decimation;
+    size_t binCount;
+    uint64_t binMin;
+    uint64_t binMax;
+
+    template <typename T>
+    void accumulateType(const T *samples, size_t n, std::vector<char> &points);
+
+public:
+    IIOEnvelope(void);
+
+    /*!
+     * Reduce samples with the given scan element format, which must be
+     * supported by IIOChannelStats, by the given factor.
+     */
+    IIOEnvelope(const IIOScanElement &element, size_t decimation);
+
+    /*!
+     * Get the size in bytes of one point.
+     */
+    size_t pointSize(void) const { return 2 * this->length; }
+
+    /*!
+     * Add n samples, appending every completed point to points.
+     */
+    void accumulate(const void *samples, size_t n, std::vector<char> &points);
+
+    /*!
+     * Drop the partial run.
+     */
+    void reset(void);
+};
+
+/*!
+ * IIOCodeHistogram counts how often each raw code of one channel occurs,
+ * with one bin per code of the channel's significant bits. Channels wider
+ * than 16 bits are binned by their top 16 bits.
+ *
+ * Consecutive samples are counted into interleaved sub-histograms, so that
+ * runs of equal codes don't serialize on one counter, and the
+ * sub-histograms are merged when the counts are read.
+ */
+class IIOCodeHistogram
+{
+private:
+    size_t length;
+    bool isSigned;
+    int64_t firstCode;
+    unsigned int binShift;
+    size_t binCount;
+    std::vector<uint32_t> subCounts;
+    std::vector<unsigned long long> totals;
+    unsigned long long pending;
+
+    template <typename T>
+    void accumulateType(const T *samples, size_t n);
+    void fold(void);
+
+public:
+    IIOCodeHistogram(void);
+
+    /*!
+     * Count samples with the given scan element format, which must be
+     * supported by IIOChannelStats.
+     */
+    IIOCodeHistogram(const IIOScanElement &element);
+
+    /*!
+     * Get the code counted by the first bin.
+     */
+    int64_t first(void) const { return this->firstCode; }
+
+    /*!
+     * Get the number of codes counted by each bin.
+     */
+    unsigned long long step(void) const { return 1ull << this->binShift; }
+
+    /*!
+     * Add n samples to the histogram.
+     */
+    void accumulate(const void *samples, size_t n);
+
+    /*!
+     * Get the count of each bin since the last reset.
+     */
+    std::vector<unsigned long long> counts(void) const;
+
+    void reset(void);
+};
@@ -0,0 +1,423 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "IIOSupport.hpp"
+#include "IIOKernels.hpp"
+#include "IIOWorkerPool.hpp"
+
+#include <json.hpp>
+using json = nlohmann::json;
+
+/***********************************************************************
+ * |PothosDoc IIO Multi-Device Sink
+ *
+ * The IIO multi-device sink forwards input sample streams to several IIO
+ * output devices that must start and stay sample-aligned.
+ *
+ * Each enabled scan element consumes an input port named
+ * "deviceId/channelId". Every device is attached to a common trigger, and
+ * buffers are interleaved and pushed in lockstep, in parallel across
+ * devices. Once every device has queued the number of prime buffers, the
+ * release attribute is written on the trigger device to start all devices
+ * together.
+ *
+ * Underflows are estimated per device from the time each device's queued
+ * samples would have run out, based on the host clock and the device's
+ * "sampling_frequency" attribute, since libiio doesn't report them. The
+ * estimate misses underflows shorter than the host's scheduling jitter and
+ * can report ones that didn't happen when the device clock drifts from the
+ * nominal rate. Devices without the attribute are never reported.
+ * They are counted by the getUnderflows probe, which returns one count per
+ * device in deviceIds order, and reported through the underflow signal,
+ * which carries the ID of the device that underflowed.
+ *
+ * |category /IIO
+ * |category /Sinks
+ * |keywords iio industrial io dac sdr array coherent synchronized
+ *
+ * |param deviceIds[Device IDs] The IDs of the IIO devices to drive.
+ * |default []
+ *
+ * |param channelIds[Channel IDs] The IDs of channels to enable on each device.
+ * If no IDs are specified, all output channels will be enabled.
+ * |preview disable
+ * |default []
+ *
+ * |param triggerId[Trigger ID] The ID of the IIO trigger device shared by
+ * all devices. If blank, the currently configured triggers are kept and no
+ * release is performed.
+ * |default ""
+ *
+ * |param bufferSize[Buffer Size] The number of samples to send to each IIO
+ * device during each push operation.
+ * |preview disable
+ * |default 2048
+ *
+ * |param primeBuffers[Prime Buffers] The number of kernel buffers to queue
+ * on every device before the shared trigger is released.
+ * |preview disable
+ * |default 4
+ *
+ * |param releaseAttribute[Release Attribute] The attribute written on the
+ * trigger device to release all devices once they are primed, in the form
+ * "attribute=value". If blank, no release write is performed.
+ * |preview disable
+ * |default "trigger_now=1"
+ *
+ * |factory /iio/multi_sink(deviceIds, channelIds, triggerId, bufferSize)
+ * |setter setPrimeBuffers(primeBuffers)
+ * |setter setReleaseAttribute(releaseAttribute)
+ **********************************************************************/
+class IIOMultiSink : public Pothos::Block
+{
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct DeviceState
+    {
+        DeviceState(IIODevice dev) : dev(dev), sampleRate(0.0), pushes(0), underflows(0), underflowed(false) {}
+
+        IIODevice dev;
+        std::unique_ptr<IIOBuffer> buf;
+        std::vector<IIOChannel> channels;
+        std::vector<std::string> portNames;
+        std::vector<void *> inputs;
+        IIOInterleaver interleaver;
+        double sampleRate;
+        unsigned long long pushes;
+        unsigned long long underflows;
+        bool underflowed;
+        Clock::time_point queuedUntil;
+    };
+
+    //pool jobs only point at the block and a device, so that they fit in
+    //std::function without an allocation, and are built once per activation
+    struct PushJob
+    {
+        IIOMultiSink *block;
+        DeviceState *d;
+        void operator()(void) const { this->block->pushDevice(*this->d); }
+    };
+
+    std::vector<DeviceState> devices;
+    std::unique_ptr<IIODevice> trigger;
+    std::unique_ptr<IIOWorkerPool> pool;
+    std::vector<IIOBuffer *> bufs;
+    std::vector<std::function<void(void)>> pushJobs;
+    size_t bufferSize;
+    unsigned int primeBuffers;
+    std::string releaseAttribute;
+    bool released;
+
+    void pushDevice(DeviceState &d)
+    {
+        //interleave straight from the input buffers
+        d.interleaver(d.inputs.data(), d.buf->start(), this->bufferSize);
+
+        //push new samples to iio device
+        d.buf->push(this->bufferSize);
+        d.pushes++;
+
+        //once running, the device underflowed if its queue ran dry before
+        //this push arrived
+        d.underflowed = false;
+        if (this->released && d.sampleRate > 0.0)
+        {
+            const auto now = Clock::now();
+            if (now > d.queuedUntil)
+            {
+                d.underflowed = true;
+                d.underflows++;
+                d.queuedUntil = now;
+            }
+            d.queuedUntil += this->bufferDuration(d);
+        }
+    }
+
+    Clock::duration bufferDuration(const DeviceState &d) const
+    {
+        return std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(this->bufferSize / d.sampleRate));
+    }
+
+    void release(void)
+    {
+        if (this->trigger && !this->releaseAttribute.empty())
+        {
+            const auto eq = this->releaseAttribute.find('=');
+            if (eq == std::string::npos)
+            {
+                throw Pothos::InvalidArgumentException("IIOMultiSink::release()", "expected attribute=value: " + this->releaseAttribute);
+            }
+            auto attr = this->trigger->attributes().at(this->releaseAttribute.substr(0, eq));
+            attr = this->releaseAttribute.substr(eq + 1);
+        }
+        this->released = true;
+
+        //every device now holds exactly primeBuffers buffers of samples
+        const auto now = Clock::now();
+        for (auto &d : this->devices)
+        {
+            if (d.sampleRate > 0.0)
+            {
+                d.queuedUntil = now + this->bufferDuration(d) * this->primeBuffers;
+            }
+        }
+    }
+
+public:
+    IIOMultiSink(const std::vector<std::string> &deviceIds, const std::vector<std::string> &channelIds,
+        const std::string &triggerId, const size_t &bufferSize)
+        : bufferSize(bufferSize), primeBuffers(4), releaseAttribute("trigger_now=1"), released(false)
+    {
+        //expose overlay hook
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOMultiSink, overlay));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOMultiSink, setPrimeBuffers));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOMultiSink, setReleaseAttribute));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOMultiSink, getUnderflows));
+        this->registerProbe("getUnderflows");
+        this->registerSignal("underflow");
+
+        //get libiio context
+        IIOContext& ctx = IIOContext::get();
+
+        if (triggerId != "")
+        {
+            this->trigger = std::unique_ptr<IIODevice>(new IIODevice(ctx.device(triggerId)));
+            if (!this->trigger->isTrigger())
+            {
+                throw Pothos::InvalidArgumentException("IIOMultiSink::IIOMultiSink()", triggerId + " is not a trigger device");
+            }
+        }
+
+        //find iio devices and set up ports for selected output channels
+        for (const auto &deviceId : deviceIds)
+        {
+            this->devices.push_back(DeviceState(ctx.device(deviceId)));
+            auto &d = this->devices.back();
+
+            for (auto c : d.dev.channels())
+            {
+                if (!c.isOutput() || !c.isScanElement())
+                    continue;
+                std::string cId = c.id();
+                if (channelIds.size() > 0 && std::none_of(channelIds.begin(), channelIds.end(),
+                        [cId](std::string s){ return s == cId; }))
+                    continue;
+                d.channels.push_back(c);
+                d.portNames.push_back(deviceId + "/" + cId);
+                this->setupInput(d.portNames.back(), c.dtype());
+            }
+        }
+
+        //the calling thread pushes to one device itself
+        if (this->devices.size() > 1)
+        {
+            this->pool = std::unique_ptr<IIOWorkerPool>(new IIOWorkerPool(this->devices.size() - 1));
+        }
+    }
+
+    std::string overlay(void) const
+    {
+        IIOContext& ctx = IIOContext::get();
+
+        json topObj;
+        auto &params = topObj["params"];
+
+        //configure triggerId dropdown options
+        json triggerIdParam;
+        triggerIdParam["key"] = "triggerId";
+        auto &triggerIdOpts = triggerIdParam["options"];
+        triggerIdParam["widgetKwargs"]["editable"] = false;
+        triggerIdParam["widgetType"] = "DropDown";
+
+        //add empty trigger option
+        json emptyOption;
+        emptyOption["name"] = "";
+        emptyOption["value"] = "\"\"";
+        triggerIdOpts.push_back(emptyOption);
+
+        //enumerate iio trigger devices
+        for (auto d : ctx.devices())
+        {
+            if (!d.isTrigger())
+                continue;
+
+            json option;
+            option["name"] = d.name() + " (" + d.id() + ")";
+            option["value"] = "\"" + d.id() + "\"";
+            triggerIdOpts.push_back(option);
+        }
+        params.push_back(triggerIdParam);
+
+        return topObj.dump();
+    }
+
+    static Block *make(const std::vector<std::string> &deviceIds, const std::vector<std::string> &channelIds,
+        const std::string &triggerId, const size_t &bufferSize)
+    {
+        return new IIOMultiSink(deviceIds, channelIds, triggerId, bufferSize);
+    }
+
+    void setPrimeBuffers(const unsigned int primeBuffers)
+    {
+        if (primeBuffers == 0)
+        {
+            throw Pothos::InvalidArgumentException("IIOMultiSink::setPrimeBuffers()", "at least one prime buffer is required");
+        }
+        this->primeBuffers = primeBuffers;
+    }
+
+    void setReleaseAttribute(const std::string &releaseAttribute)
+    {
+        this->releaseAttribute = releaseAttribute;
+    }
+
+    std::vector<unsigned long long> getUnderflows(void) const
+    {
+        std::vector<unsigned long long> underflows;
+        for (const auto &d : this->devices)
+        {
+            underflows.push_back(d.underflows);
+        }
+        return underflows;
+    }
+
+    void activate(void)
+    {
+        if (this->devices.empty())
+        {
+            throw Pothos::SystemException("IIOMultiSink::activate()", "no devices specified");
+        }
+
+        this->released = false;
+        for (auto &d : this->devices)
+        {
+            d.buf.reset();
+            d.pushes = 0;
+            d.underflows = 0;
+        }
+
+        //attach every device to the shared trigger before any buffer is
+        //enabled, so that all devices start on the same trigger event
+        if (this->trigger)
+        {
+            for (auto &d : this->devices)
+            {
+                d.dev.setTrigger(this->trigger.get());
+            }
+        }
+
+        for (auto &d : this->devices)
+        {
+            if (d.channels.empty())
+            {
+                throw Pothos::SystemException("IIOMultiSink::activate()", "no scan elements enabled on " + d.dev.id());
+            }
+            for (auto c : d.channels)
+            {
+                c.enable();
+            }
+
+            //the sample rate is only used for underflow detection
+            d.sampleRate = 0.0;
+            try
+            {
+                d.sampleRate = std::stod(d.dev.attributes().at("sampling_frequency").value());
+            }
+            catch (const Pothos::Exception &) {}
+            catch (const std::logic_error &) {}
+
+            //make room to prime the whole queue before the release
+            d.dev.setKernelBuffersCount(this->primeBuffers);
+            d.buf = std::unique_ptr<IIOBuffer>(new IIOBuffer(std::move(d.dev.createBuffer(this->bufferSize, false))));
+            d.buf->setBlockingMode(false);
+            d.interleaver = IIOInterleaver(*d.buf, d.channels);
+            d.inputs.assign(d.portNames.size(), nullptr);
+        }
+
+        //everything work() hands to the pool is set up here
+        this->bufs.clear();
+        this->pushJobs.clear();
+        for (auto &d : this->devices)
+        {
+            this->bufs.push_back(d.buf.get());
+            this->pushJobs.push_back(PushJob{this, &d});
+        }
+    }
+
+    void deactivate(void)
+    {
+        this->bufs.clear();
+        for (auto &d : this->devices)
+        {
+            d.buf.reset();
+        }
+    }
+
+    void work(void)
+    {
+        if (this->devices.empty() || !this->devices.front().buf)
+            return;
+
+        //every device pushes whole buffers in lockstep
+        if (this->workInfo().minInElements < this->bufferSize)
+            return;
+
+        //wait until every device has room for another buffer
+        if (!IIOBuffer::waitAll(this->bufs, true, this->workInfo().maxTimeoutNs))
+        {
+            //the kernel queue filled up before reaching primeBuffers
+            if (!this->released && this->devices.front().pushes > 0)
+            {
+                this->release();
+            }
+            return this->yield();
+        }
+
+        //interleave and push every device in parallel
+        for (auto &d : this->devices)
+        {
+            for (size_t i = 0; i < d.portNames.size(); ++i)
+            {
+                d.inputs[i] = this->input(d.portNames[i])->buffer().as<void *>();
+            }
+        }
+        if (this->pool)
+        {
+            this->pool->run(this->pushJobs);
+        }
+        else
+        {
+            this->pushJobs.front()();
+        }
+
+        //consume samples
+        for (auto &d : this->devices)
+        {
+            for (const auto &name : d.portNames)
+            {
+                this->input(name)->consume(this->bufferSize);
+            }
+            if (d.underflowed)
+            {
+                this->emitSignal("underflow", d.dev.id());
+            }
+        }
+
+        //release the shared trigger once every device is primed
+        if (!this->released && this->devices.front().pushes >= this->primeBuffers)
+        {
+            this->release();
+        }
+    }
+};
+
+static Pothos::BlockRegistry registerIIOMultiSink(
+    "/iio/multi_sink", &IIOMultiSink::make);
@@ -0,0 +1,388 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "IIOSupport.hpp"
+#include "IIOKernels.hpp"
+#include "IIOWorkerPool.hpp"
+
+#include <json.hpp>
+using json = nlohmann::json;
+
+/***********************************************************************
+ * |PothosDoc IIO Multi-Device Source
+ *
+ * The IIO multi-device source samples several IIO input devices coherently
+ * and forwards them to sample-aligned output streams.
+ *
+ * All devices are attached to a common trigger and their buffers are
+ * refilled in lockstep, in parallel across devices. Each enabled scan
+ * element produces an output port named "deviceId/channelId".
+ *
+ * A refill that returns fewer samples on some devices than on others only
+ * delivers the samples every device has, and the rest are delivered with
+ * the next refill of the devices that fell short, so that the ports stay
+ * aligned sample for sample.
+ *
+ * Alignment can only be checked against the hardware when every device has
+ * an enabled "timestamp" scan element. Then the first timestamps of each
+ * device must agree to within half a sample period at every delivery, and
+ * misaligned deliveries are marked with an "alignmentError" label on every
+ * port and counted by the alignmentErrors probe. Without timestamps, the
+ * alignment relies on the shared trigger and is not checked.
+ *
+ * |category /IIO
+ * |category /Sources
+ * |keywords iio industrial io adc sdr array coherent synchronized
+ *
+ * |param deviceIds[Device IDs] The IDs of the IIO devices to sample.
+ * |default []
+ *
+ * |param channelIds[Channel IDs] The IDs of channels to enable on each device.
+ * If no IDs are specified, all input channels will be enabled.
+ * |preview disable
+ * |default []
+ *
+ * |param triggerId[Trigger ID] The ID of the IIO trigger device shared by
+ * all devices. If blank, the currently configured triggers are kept.
+ * |default ""
+ *
+ * |param bufferSize[Buffer Size] The number of samples to obtain from each
+ * IIO device during each refill operation.
+ * |preview disable
+ * |default 2048
+ *
+ * |factory /iio/multi_source(deviceIds, channelIds, triggerId, bufferSize)
+ **********************************************************************/
+class IIOMultiSource : public Pothos::Block
+{
+private:
+    struct DeviceState
+    {
+        DeviceState(IIODevice dev) : dev(dev), due(false), sampleCount(0), offset(0), firstTimestamp(0), lastTimestamp(0) {}
+
+        IIODevice dev;
+        std::unique_ptr<IIOBuffer> buf;
+        std::vector<IIOChannel> channels;
+        std::vector<std::string> portNames;
+        std::vector<void *> outputs;
+        IIODeinterleaver deinterleaver;
+        std::unique_ptr<IIOChannel> timestamp;
+        bool due;
+        size_t sampleCount;
+        size_t offset;
+        int64_t firstTimestamp;
+        int64_t lastTimestamp;
+    };
+
+    //pool jobs only point at the block and a device, so that they fit in
+    //std::function without an allocation, and are built once per activation
+    struct RefillJob
+    {
+        IIOMultiSource *block;
+        DeviceState *d;
+        void operator()(void) const { if (this->d->due) this->block->refillDevice(*this->d); }
+    };
+
+    struct DeliverJob
+    {
+        IIOMultiSource *block;
+        DeviceState *d;
+        void operator()(void) const { this->block->deliverDevice(*this->d, this->block->deliverCount); }
+    };
+
+    std::vector<DeviceState> devices;
+    std::unique_ptr<IIODevice> trigger;
+    std::unique_ptr<IIOWorkerPool> pool;
+    std::vector<IIOBuffer *> dueBufs;
+    std::vector<std::function<void(void)>> refillJobs;
+    std::vector<std::function<void(void)>> deliverJobs;
+    size_t deliverCount;
+    size_t bufferSize;
+    unsigned long long alignmentErrors;
+
+    void refillDevice(DeviceState &d)
+    {
+        //get new samples from iio device
+        auto bytes_read = d.buf->refill();
+        //libiio read operations shouldn't return partial scans
+        assert(bytes_read % d.buf->step() == 0);
+        d.sampleCount = bytes_read / d.buf->step();
+        d.offset = 0;
+    }
+
+    void deliverDevice(DeviceState &d, const size_t n)
+    {
+        //deinterleave straight into the output buffers, from where the
+        //last delivery left off
+        const auto scans = static_cast<const char *>(d.buf->start()) + d.offset * d.buf->step();
+        d.deinterleaver(scans, d.outputs.data(), n);
+
+        //latch the timestamps at either end of the delivery
+        if (d.timestamp && n > 0)
+        {
+            auto first = static_cast<char *>(d.buf->first(*d.timestamp)) + d.offset * d.buf->step();
+            d.timestamp->convert(&d.firstTimestamp, first);
+            d.timestamp->convert(&d.lastTimestamp, first + (n - 1) * d.buf->step());
+        }
+        d.offset += n;
+    }
+
+    bool checkAlignment(const size_t n, int64_t &skew)
+    {
+        //host-side counters agree by construction, so only hardware
+        //timestamps can tell
+        const bool haveTimestamps = std::all_of(this->devices.begin(), this->devices.end(),
+            [](const DeviceState &d){ return bool(d.timestamp); });
+        if (!haveTimestamps || n < 2) return true;
+
+        const auto &ref = this->devices.front();
+        const int64_t halfPeriod = (ref.lastTimestamp - ref.firstTimestamp) / int64_t(2 * (n - 1));
+        skew = 0;
+        for (const auto &d : this->devices)
+        {
+            skew = std::max<int64_t>(skew, std::abs(d.firstTimestamp - ref.firstTimestamp));
+        }
+        return skew <= halfPeriod;
+    }
+
+public:
+    IIOMultiSource(const std::vector<std::string> &deviceIds, const std::vector<std::string> &channelIds,
+        const std::string &triggerId, const size_t &bufferSize)
+        : deliverCount(0), bufferSize(bufferSize), alignmentErrors(0)
+    {
+        //expose overlay hook
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOMultiSource, overlay));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOMultiSource, getAlignmentErrors));
+        this->registerProbe("getAlignmentErrors");
+
+        //get libiio context
+        IIOContext& ctx = IIOContext::get();
+
+        if (triggerId != "")
+        {
+            this->trigger = std::unique_ptr<IIODevice>(new IIODevice(ctx.device(triggerId)));
+            if (!this->trigger->isTrigger())
+            {
+                throw Pothos::InvalidArgumentException("IIOMultiSource::IIOMultiSource()", triggerId + " is not a trigger device");
+            }
+        }
+
+        //find iio devices and set up ports for selected input channels
+        for (const auto &deviceId : deviceIds)
+        {
+            this->devices.push_back(DeviceState(ctx.device(deviceId)));
+            auto &d = this->devices.back();
+
+            for (auto c : d.dev.channels())
+            {
+                if (c.isOutput() || !c.isScanElement())
+                    continue;
+                std::string cId = c.id();
+                if (channelIds.size() > 0 && std::none_of(channelIds.begin(), channelIds.end(),
+                        [cId](std::string s){ return s == cId; }))
+                    continue;
+                d.channels.push_back(c);
+                d.portNames.push_back(deviceId + "/" + cId);
+                this->setupOutput(d.portNames.back(), c.dtype());
+
+                if (cId == "timestamp")
+                {
+                    d.timestamp = std::unique_ptr<IIOChannel>(new IIOChannel(c));
+                }
+            }
+        }
+
+        //the calling thread refills one device itself
+        if (this->devices.size() > 1)
+        {
+            this->pool = std::unique_ptr<IIOWorkerPool>(new IIOWorkerPool(this->devices.size() - 1));
+        }
+    }
+
+    std::string overlay(void) const
+    {
+        IIOContext& ctx = IIOContext::get();
+
+        json topObj;
+        auto &params = topObj["params"];
+
+        //configure triggerId dropdown options
+        json triggerIdParam;
+        triggerIdParam["key"] = "triggerId";
+        auto &triggerIdOpts = triggerIdParam["options"];
+        triggerIdParam["widgetKwargs"]["editable"] = false;
+        triggerIdParam["widgetType"] = "DropDown";
+
+        //add empty trigger option
+        json emptyOption;
+        emptyOption["name"] = "";
+        emptyOption["value"] = "\"\"";
+        triggerIdOpts.push_back(emptyOption);
+
+        //enumerate iio trigger devices
+        for (auto d : ctx.devices())
+        {
+            if (!d.isTrigger())
+                continue;
+
+            json option;
+            option["name"] = d.name() + " (" + d.id() + ")";
+            option["value"] = "\"" + d.id() + "\"";
+            triggerIdOpts.push_back(option);
+        }
+        params.push_back(triggerIdParam);
+
+        return topObj.dump();
+    }
+
+    static Block *make(const std::vector<std::string> &deviceIds, const std::vector<std::string> &channelIds,
+        const std::string &triggerId, const size_t &bufferSize)
+    {
+        return new IIOMultiSource(deviceIds, channelIds, triggerId, bufferSize);
+    }
+
+    unsigned long long getAlignmentErrors(void) const
+    {
+        return this->alignmentErrors;
+    }
+
+    void activate(void)
+    {
+        if (this->devices.empty())
+        {
+            throw Pothos::SystemException("IIOMultiSource::activate()", "no devices specified");
+        }
+
+        for (auto &d : this->devices)
+        {
+            d.buf.reset();
+            d.sampleCount = 0;
+            d.offset = 0;
+        }
+
+        //attach every device to the shared trigger before any buffer is
+        //enabled, so that all devices start on the same trigger event
+        if (this->trigger)
+        {
+            for (auto &d : this->devices)
+            {
+                d.dev.setTrigger(this->trigger.get());
+            }
+        }
+
+        for (auto &d : this->devices)
+        {
+            if (d.channels.empty())
+            {
+                throw Pothos::SystemException("IIOMultiSource::activate()", "no scan elements enabled on " + d.dev.id());
+            }
+            for (auto c : d.channels)
+            {
+                c.enable();
+            }
+
+            d.buf = std::unique_ptr<IIOBuffer>(new IIOBuffer(std::move(d.dev.createBuffer(this->bufferSize, false))));
+            d.buf->setBlockingMode(false);
+            d.deinterleaver = IIODeinterleaver(*d.buf, d.channels);
+            d.outputs.assign(d.portNames.size(), nullptr);
+        }
+
+        //everything work() hands to the pool is set up here
+        this->dueBufs.clear();
+        this->dueBufs.reserve(this->devices.size());
+        this->refillJobs.clear();
+        this->deliverJobs.clear();
+        for (auto &d : this->devices)
+        {
+            this->refillJobs.push_back(RefillJob{this, &d});
+            this->deliverJobs.push_back(DeliverJob{this, &d});
+        }
+    }
+
+    void deactivate(void)
+    {
+        for (auto &d : this->devices)
+        {
+            d.buf.reset();
+        }
+    }
+
+    void work(void)
+    {
+        if (this->devices.empty() || !this->devices.front().buf)
+            return;
+
+        //verify we have enough space in our output buffers to refill
+        if (this->workInfo().minOutElements < this->bufferSize)
+            return;
+
+        //wait until every device that delivered all of its last refill has
+        //samples ready; the others still hold samples from a short refill
+        //of another device
+        this->dueBufs.clear();
+        for (auto &d : this->devices)
+        {
+            d.due = d.offset >= d.sampleCount;
+            if (d.due) this->dueBufs.push_back(d.buf.get());
+        }
+        if (!this->dueBufs.empty())
+        {
+            if (!IIOBuffer::waitAll(this->dueBufs, false, this->workInfo().maxTimeoutNs))
+                return this->yield();
+
+            //refill those devices in lockstep, in parallel; jobs for the
+            //devices that aren't due do nothing
+            if (this->pool && this->dueBufs.size() > 1) this->pool->run(this->refillJobs);
+            else for (const auto &job : this->refillJobs) job();
+        }
+
+        //only the samples every device has are delivered, and the rest are
+        //kept for the next call
+        size_t sample_count = this->bufferSize;
+        for (const auto &d : this->devices)
+        {
+            sample_count = std::min(sample_count, d.sampleCount - d.offset);
+        }
+
+        for (auto &d : this->devices)
+        {
+            for (size_t i = 0; i < d.portNames.size(); ++i)
+            {
+                d.outputs[i] = this->output(d.portNames[i])->buffer().as<void *>();
+            }
+        }
+        this->deliverCount = sample_count;
+        if (this->pool) this->pool->run(this->deliverJobs);
+        else this->deliverJobs.front()();
+
+        int64_t skew = 0;
+        const bool aligned = this->checkAlignment(sample_count, skew);
+        if (!aligned)
+        {
+            this->alignmentErrors++;
+        }
+
+        for (const auto &d : this->devices)
+        {
+            for (const auto &name : d.portNames)
+            {
+                auto outputPort = this->output(name);
+                if (!aligned)
+                {
+                    outputPort->postLabel(Pothos::Label("alignmentError", skew, 0));
+                }
+                outputPort->produce(sample_count);
+            }
+        }
+    }
+};
+
+static Pothos::BlockRegistry registerIIOMultiSource(
+    "/iio/multi_source", &IIOMultiSource::make);
@@ -0,0 +1,164 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include "IIOReactor.hpp"
+#include <Pothos/Framework.hpp>
+#include <Poco/Error.h>
+#include <cerrno>
+#include <cstdint>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+//the most readiness events handled per wakeup
+static const int maxEvents = 64;
+
+/***********************************************************************
+ * Waiter
+ **********************************************************************/
+IIOReactorWaiter::IIOReactorWaiter(IIOReactor &reactor, int fd, const std::function<void(void)> &notify)
+    : reactor(reactor), fd(fd), notify(notify), ready(false), armed(true) {}
+
+IIOReactorWaiter::~IIOReactorWaiter(void)
+{
+    this->reactor.remove(this);
+}
+
+bool IIOReactorWaiter::takeReady(void)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->ready)
+    {
+        this->ready = false;
+        return true;
+    }
+
+    //re-arm for the next event once the last one has been taken
+    if (!this->armed)
+    {
+        this->armed = true;
+        lock.unlock();
+        try
+        {
+            this->reactor.arm(this, false);
+        }
+        catch (...)
+        {
+            lock.lock();
+            this->armed = false;
+            throw;
+        }
+    }
+    return false;
+}
+
+/***********************************************************************
+ * Reactor
+ **********************************************************************/
+IIOReactor::IIOReactor(void) : epollFd(-1), wakeFd(-1)
+{
+    #ifdef __linux__
+    this->epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (this->epollFd < 0)
+    {
+        throw Pothos::SystemException("IIOReactor::IIOReactor()", "epoll_create1: " + Poco::Error::getMessage(errno));
+    }
+    this->wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.ptr = nullptr;
+    if (this->wakeFd < 0 || epoll_ctl(this->epollFd, EPOLL_CTL_ADD, this->wakeFd, &ev) < 0)
+    {
+        const int err = errno;
+        if (this->wakeFd >= 0) close(this->wakeFd);
+        close(this->epollFd);
+        throw Pothos::SystemException("IIOReactor::IIOReactor()", "eventfd: " + Poco::Error::getMessage(err));
+    }
+    this->thread = std::thread(&IIOReactor::threadLoop, this);
+    #endif
+}
+
+IIOReactor::~IIOReactor(void)
+{
+    #ifdef __linux__
+    //the wakeup descriptor tells the thread to exit
+    const uint64_t one = 1;
+    if (write(this->wakeFd, &one, sizeof(one)) < 0) {}
+    if (this->thread.joinable()) this->thread.join();
+    close(this->wakeFd);
+    close(this->epollFd);
+    #endif
+}
+
+IIOReactor &IIOReactor::get(void)
+{
+    static Poco::SingletonHolder<IIOReactor> sh;
+    return *sh.get();
+}
+
+void IIOReactor::threadLoop(void)
+{
+    #ifdef __linux__
+    struct epoll_event events[maxEvents];
+    while (true)
+    {
+        const int n = epoll_wait(this->epollFd, events, maxEvents, -1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return;
+
+        //waiters removed since epoll_wait returned are skipped, and the
+        //lock keeps each one alive while it is notified
+        std::lock_guard<std::mutex> lock(this->mutex);
+        for (int i = 0; i < n; ++i)
+        {
+            auto waiter = static_cast<IIOReactorWaiter *>(events[i].data.ptr);
+            if (waiter == nullptr) return;
+            if (this->waiters.count(waiter) == 0) continue;
+            {
+                std::lock_guard<std::mutex> waiterLock(waiter->mutex);
+                waiter->ready = true;
+                waiter->armed = false;
+            }
+            waiter->notify();
+        }
+    }
+    #endif
+}
+
+void IIOReactor::arm(IIOReactorWaiter *waiter, bool add)
+{
+    #ifdef __linux__
+    //one-shot events leave the descriptor alone until its owner re-arms it
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.ptr = waiter;
+    if (epoll_ctl(this->epollFd, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, waiter->fd, &ev) < 0)
+    {
+        throw Pothos::SystemException("IIOReactor::arm()", "epoll_ctl: " + Poco::Error::getMessage(errno));
+    }
+    #endif
+}
+
+void IIOReactor::remove(IIOReactorWaiter *waiter)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    #ifdef __linux__
+    epoll_ctl(this->epollFd, EPOLL_CTL_DEL, waiter->fd, nullptr);
+    #endif
+    this->waiters.erase(waiter);
+}
+
+std::unique_ptr<IIOReactorWaiter> IIOReactor::add(int fd, const std::function<void(void)> &notify)
+{
+    #ifndef __linux__
+    throw Pothos::NotImplementedException("IIOReactor::add()", "the reactor needs epoll");
+    #endif
+    std::unique_ptr<IIOReactorWaiter> waiter(new IIOReactorWaiter(*this, fd, notify));
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->waiters.insert(waiter.get());
+    }
+    this->arm(waiter.get(), true);
+    return waiter;
+}
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <Poco/SingletonHolder.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
+class IIOReactor;
+
+/*!
+ * IIOReactorWaiter is one file descriptor registered with the IIOReactor.
+ * It is armed for a single readiness event at a time. When the descriptor
+ * becomes readable, the reactor thread calls the owner's notify function
+ * once, which must only hand the event over, such as by posting a message
+ * to the owning block, and never wait on the owner. The owner takes the
+ * event with takeReady(), which re-arms the descriptor once it has been
+ * taken. Unregistered on destruction, which must happen before the
+ * descriptor is closed, and after which notify is no longer called.
+ */
+class IIOReactorWaiter
+{
+    friend class IIOReactor;
+private:
+    IIOReactor &reactor;
+    int fd;
+    std::function<void(void)> notify;
+    std::mutex mutex;
+    bool ready;
+    bool armed;
+
+    IIOReactorWaiter(IIOReactor &reactor, int fd, const std::function<void(void)> &notify);
+
+public:
+    ~IIOReactorWaiter(void);
+
+    IIOReactorWaiter(const IIOReactorWaiter&) = delete;
+    IIOReactorWaiter& operator=(const IIOReactorWaiter&) = delete;
+
+    /*!
+     * Take a readiness event without blocking. Returns false if there is
+     * none yet, in which case the descriptor is re-armed and notify will be
+     * called when it becomes readable.
+     */
+    bool takeReady(void);
+};
+
+/*!
+ * IIOReactor waits on the file descriptors of many IIO buffers from one
+ * process-wide thread, so that blocks streaming from many low-rate devices
+ * return from work() until their own buffer is ready instead of each
+ * polling it, and are only woken for buffers that are ready. Only
+ * supported on Linux, where it uses epoll.
+ */
+class IIOReactor
+{
+    friend class Poco::SingletonHolder<IIOReactor>;
+    friend class IIOReactorWaiter;
+private:
+    int epollFd;
+    int wakeFd;
+    std::mutex mutex;
+    std::set<IIOReactorWaiter *> waiters;
+    std::thread thread;
+
+    IIOReactor(void);
+    void threadLoop(void);
+    void arm(IIOReactorWaiter *waiter, bool add);
+    void remove(IIOReactorWaiter *waiter);
+
+public:
+    ~IIOReactor(void);
+
+    /*!
+     * Get the global instance of the IIOReactor object, starting its thread
+     * on first use.
+     */
+    static IIOReactor &get(void);
+
+    /*!
+     * Register a readable file descriptor, armed for its first event, with
+     * the function to call from the reactor thread when it is ready.
+     */
+    std::unique_ptr<IIOReactorWaiter> add(int fd, const std::function<void(void)> &notify);
+};
@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include "IIOReactor.hpp"
+
+/***********************************************************************
+ * Compares the CPU used to wait on many low-rate devices by polling each
+ * descriptor with a work timeout, the way blocks did before the reactor,
+ * with the IIOReactor handing ready descriptors to a single consumer.
+ * Eventfds stand in for buffer descriptors, so that no IIO device is
+ * needed. The device count is the first argument. Linux only, built with
+ * ENABLE_IIO_BENCHMARKS.
+ **********************************************************************/
+
+//how often each device completes a buffer, in Hz, the poll timeout that
+//stands in for the work timeout, and the seconds timed per mode
+static const double benchRate = 100.0;
+static const int pollTimeoutMs = 1;
+static const double benchSeconds = 2.0;
+
+static double cpuSeconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void takeEvent(const int fd)
+{
+    uint64_t value = 0;
+    if (read(fd, &value, sizeof(value)) < 0) {}
+}
+
+template <typename Fcn>
+static void benchMode(const char *name, const std::vector<int> &fds, const Fcn &waitAll)
+{
+    //every device completes a buffer at the same rate
+    std::atomic<bool> running(true);
+    std::atomic<unsigned long long> events(0);
+    std::thread producer([&]{
+        const uint64_t one = 1;
+        while (running)
+        {
+            std::this_thread::sleep_for(std::chrono::duration<double>(1.0 / benchRate));
+            for (const int fd : fds) if (write(fd, &one, sizeof(one)) < 0) {}
+        }
+    });
+
+    const auto startCpu = cpuSeconds();
+    const auto start = std::chrono::steady_clock::now();
+    waitAll(running, events);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    const double cpu = cpuSeconds() - startCpu;
+    producer.join();
+
+    std::printf("%-8s %5zu devices %7.1f%% CPU %9.0f events/s\n",
+        name, fds.size(), 100.0 * cpu / elapsed.count(), events / elapsed.count());
+}
+
+static void benchDevices(const size_t devices)
+{
+    std::vector<int> fds;
+    for (size_t i = 0; i < devices; ++i) fds.push_back(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+
+    //one thread per device, each polling its descriptor with a timeout
+    benchMode("polling", fds, [&](std::atomic<bool> &running, std::atomic<unsigned long long> &events)
+    {
+        std::vector<std::thread> threads;
+        for (const int fd : fds) threads.push_back(std::thread([&, fd]{
+            while (running)
+            {
+                struct pollfd pfd = {fd, POLLIN, 0};
+                if (poll(&pfd, 1, pollTimeoutMs) <= 0) continue;
+                takeEvent(fd);
+                events++;
+            }
+        }));
+        std::this_thread::sleep_for(std::chrono::duration<double>(benchSeconds));
+        running = false;
+        for (auto &t : threads) t.join();
+    });
+
+    //one reactor thread, handing ready descriptors to one consumer, the
+    //way reactor blocks are woken through a slot
+    benchMode("reactor", fds, [&](std::atomic<bool> &running, std::atomic<unsigned long long> &events)
+    {
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::deque<size_t> ready;
+        std::vector<std::unique_ptr<IIOReactorWaiter>> waiters;
+        for (size_t i = 0; i < fds.size(); ++i) waiters.push_back(IIOReactor::get().add(fds[i], [&, i]{
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.push_back(i);
+            cond.notify_one();
+        }));
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(benchSeconds));
+        std::unique_lock<std::mutex> lock(mutex);
+        while (std::chrono::steady_clock::now() < deadline &&
+            cond.wait_until(lock, deadline, [&]{ return !ready.empty(); }))
+        {
+            const size_t i = ready.front();
+            ready.pop_front();
+            lock.unlock();
+            while (waiters[i]->takeReady())
+            {
+                takeEvent(fds[i]);
+                events++;
+            }
+            lock.lock();
+        }
+        lock.unlock();
+        running = false;
+        waiters.clear();
+    });
+
+    for (const int fd : fds) close(fd);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        benchDevices(std::strtoul(argv[1], nullptr, 10));
+        return 0;
+    }
+    for (const size_t devices : {8, 64, 256}) benchDevices(devices);
+    return 0;
+}
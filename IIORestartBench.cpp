@@ -0,0 +1,149 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Pothos/Init.hpp>
+#include <Pothos/Proxy.hpp>
+#include "IIOSupport.hpp"
+
+/***********************************************************************
+ * Compares a cold restart, which destroys and recreates the buffer the
+ * way IIOSource does without Warm Restart, with a warm restart, which
+ * keeps the buffer and discards the samples queued meanwhile. Each
+ * restart is timed up to the first fresh refill. Also times constructing
+ * an IIO source block on the device with Attribute Calls off, where the
+ * attribute index is only built on first use, and on, where every
+ * attribute is listed and registered as a callable. Needs an input
+ * device in the default IIO context, and the IIO blocks installed in the
+ * Pothos module path. Built with ENABLE_IIO_BENCHMARKS.
+ *
+ * Usage: IIORestartBench deviceId [bufferSize] [restarts]
+ **********************************************************************/
+
+//how long each restart leaves the device idle, like a paused topology
+static const double idleTime = 0.05;
+
+//the longest a warm restart spends discarding stale buffers, as IIOSource
+static const double maxFlushTime = 0.005;
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(const Clock::time_point &start)
+{
+    const std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+    return elapsed.count();
+}
+
+static void idle(void)
+{
+    std::this_thread::sleep_for(std::chrono::duration<double>(idleTime));
+}
+
+static std::unique_ptr<IIOBuffer> openBuffer(IIODevice &dev, const size_t bufferSize)
+{
+    std::unique_ptr<IIOBuffer> buf(new IIOBuffer(dev.createBuffer(bufferSize, false)));
+    buf->setBlockingMode(false);
+    return buf;
+}
+
+static double constructMs(const std::string &deviceId, const size_t bufferSize, const bool attributeCalls)
+{
+    //the block is destroyed before the clock stops, like a topology rebuild
+    const auto start = Clock::now();
+    {
+        auto block = Pothos::BlockRegistry::make("/iio/source", deviceId, std::vector<std::string>(), true, bufferSize);
+        if (attributeCalls) block.call("setAttributeCallables", true);
+    }
+    return msSince(start);
+}
+
+static void refill(IIOBuffer &buf)
+{
+    std::vector<IIOBuffer *> bufs(1, &buf);
+    if (!IIOBuffer::waitAll(bufs, false, 1000000000LL))
+    {
+        throw Pothos::TimeoutException("IIORestartBench", "no samples within 1 s");
+    }
+    buf.refill();
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "Usage: %s deviceId [bufferSize] [restarts]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    const size_t bufferSize = argc > 2 ? std::stoul(argv[2]) : 4096;
+    const size_t restarts = argc > 3 ? std::stoul(argv[3]) : 20;
+
+    try
+    {
+        auto dev = IIOContext::get().device(argv[1]);
+        for (auto c : dev.channels())
+        {
+            if (c.isScanElement() && !c.isOutput()) c.enable();
+        }
+
+        double cold = 0.0;
+        for (size_t i = 0; i < restarts; ++i)
+        {
+            auto buf = openBuffer(dev, bufferSize);
+            refill(*buf);
+            buf.reset();
+            idle();
+
+            const auto start = Clock::now();
+            buf = openBuffer(dev, bufferSize);
+            refill(*buf);
+            cold += msSince(start);
+        }
+
+        double warm = 0.0;
+        size_t flushed = 0;
+        auto buf = openBuffer(dev, bufferSize);
+        std::vector<IIOBuffer *> bufs(1, buf.get());
+        refill(*buf);
+        for (size_t i = 0; i < restarts; ++i)
+        {
+            idle();
+
+            const auto start = Clock::now();
+            const auto deadline = start + std::chrono::duration<double>(maxFlushTime);
+            while (Clock::now() < deadline && IIOBuffer::waitAll(bufs, false, 0))
+            {
+                buf->refill();
+                flushed++;
+            }
+            refill(*buf);
+            warm += msSince(start);
+        }
+
+        std::printf("cold restart %8.3f ms  warm restart %8.3f ms  (%.1f stale buffers discarded per restart)\n",
+            cold / restarts, warm / restarts, double(flushed) / restarts);
+        buf.reset();
+
+        //the first construction also loads the module and the context
+        Pothos::ScopedInit init;
+        constructMs(argv[1], bufferSize, true);
+        double callsOff = 0.0, callsOn = 0.0;
+        for (size_t i = 0; i < restarts; ++i)
+        {
+            callsOff += constructMs(argv[1], bufferSize, false);
+            callsOn += constructMs(argv[1], bufferSize, true);
+        }
+        std::printf("construction %8.3f ms with Attribute Calls off  %8.3f ms with them on\n",
+            callsOff / restarts, callsOn / restarts);
+    }
+    catch (const Pothos::Exception &ex)
+    {
+        std::fprintf(stderr, "%s\n", ex.displayText().c_str());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -9,20 +9,142 @@
 #include <winsock2.h>
 #endif
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <map>
 #include <memory>
+#include <stdexcept>
 #include <string>
 #include <cstring>
+#include <thread>
 #include <vector>
 #include "IIOSupport.hpp"
+#include "IIOKernels.hpp"
+#include "IIOCommandQueue.hpp"
+#include "IIOAttrWatcher.hpp"
+#include "IIOAttrIndex.hpp"
+#include "IIOBufferTuner.hpp"
+#include "IIOCalibration.hpp"
 
 #include <json.hpp>
 using json = nlohmann::json;
 
+//the number of samples converted or predistorted per block, small enough
+//to stay in cache
+static const size_t convertBlock = 4096;
+
+//the kernel buffer count libiio allocates by default
+static const size_t defaultKernelBuffers = 4;
+
 /***********************************************************************
  * |PothosDoc IIO Sink
  *
  * The IIO sink forwards an input sample stream to an IIO output device.
  *
+ * Attribute writes can be scheduled at a sample index of the input stream,
+ * counted from zero at activation, with scheduleDeviceAttribute() and
+ * scheduleChannelAttribute(). A write applies from the sample the device is
+ * playing when it is issued, behind the samples still queued in the kernel.
+ * The queue is tracked from the device's "sampling_frequency" attribute,
+ * and each write is issued from the push closest to the moment playback
+ * reaches its index, to within half a buffer. Without a sample rate, pushes
+ * are split so that a buffer boundary falls on each requested index and the
+ * write is issued between the two pushes, so it lands early by up to the
+ * kernel queue, Kernel Buffers times Buffer Size samples, which the offset
+ * can't show. Each write is reported through the attributeChanged signal,
+ * with the "attribute" name, the new "value", the "channel" ID for channel
+ * attributes, the "requestedIndex" and the achieved "offset" in samples.
+ * Scheduled writes still pending when the block deactivates are dropped.
+ *
+ * Attributes are named by path: "attr" for a device attribute, and
+ * "channelId/attr" for a channel attribute. They can always be accessed on
+ * demand through getAttribute(path) and setAttribute(path, value), and
+ * getAttributePaths() lists them. When Attribute Calls is enabled, a
+ * deviceAttribute[attr]/channelAttribute[channelId][attr] probe and setter
+ * is also registered for every attribute; disabling it skips listing the
+ * attributes at construction, which only matters on devices with many
+ * attributes. Attribute Calls defaults to on in the block factory, but a
+ * block constructed directly starts with it off, so code that constructs
+ * one and relies on the deviceAttribute[attr] probes must call
+ * setAttributeCallables(true) first.
+ *
+ * Device debug attributes are also available on demand, named
+ * "debug/attr". Device registers can be accessed with readRegister(address)
+ * and writeRegister(address, value), or in a batch with
+ * registerTransaction(ops). In that case ops is a JSON array of
+ * {"address": a} reads and {"address": a, "value": v} writes, which are
+ * applied in order, and the result is a JSON array holding the value read
+ * or written by each operation. A transaction is still one libiio register
+ * read or write per operation; it only saves the round trip through the
+ * block call for each one. Malformed ops are rejected before any
+ * operation is applied. Debug attributes are only listed on first use.
+ *
+ * Attributes listed in Watch Attributes are polled in bulk on a background
+ * thread every Watch Interval. Changed values are reported through the
+ * attributesChanged signal as a map from attribute path to new value.
+ * Every watched attribute is reported once with its initial value.
+ * Notifications are emitted from the block's work() calls. While the block
+ * has nothing to stream, work() waits up to the work timeout for changes
+ * and yields, so that they are still reported. An inactive block keeps its
+ * changes until it is activated.
+ *
+ * With Warm Restart enabled, the buffer is kept allocated when the block
+ * deactivates, and reused by the next activation if its configuration is
+ * unchanged, which skips kernel buffer allocation and DMA setup. libiio
+ * can't disable a buffer without freeing it, so the device keeps streaming
+ * while the block is inactive, with the buffer left to underflow.
+ *
+ * Calling drain() puts the sink in a draining state, where work() keeps
+ * pushing input until the ports run dry and then, if the device has a
+ * "sampling_frequency" attribute, until the kernel queue has played out.
+ * The drained signal is then emitted with the number of samples sent out,
+ * so that the topology can be stopped without cutting the stream short.
+ * On deactivation the sink waits at most Drain Timeout for the kernel
+ * queue to play out before freeing its buffer; input still waiting on the
+ * ports can't be pushed from there and is dropped. getFlushedSamples() and
+ * getDroppedSamples() report how many samples the last drain sent out and
+ * how many it had to abandon, where kernel queue contents are estimated
+ * from the sample rate.
+ *
+ * Calibration predistorts the samples of chosen channels as they are
+ * interleaved, undoing the correction the IIO source applies with the same
+ * calibration, so that a calibrated signal comes out of the device as
+ * given. It takes the same JSON object or file path, keyed by device ID and
+ * then channel ID. Predistortion maps each code to the code whose
+ * correction is nearest to it; channels wider than 16 bits only support
+ * linear corrections. A new calibration takes effect from the next push.
+ *
+ * Input Format selects what the input ports take. DEVICE ports carry each
+ * channel's raw device sample type. FLOAT32 adds a float port per channel,
+ * named after the channel ID with a "_float" suffix, and COMPLEX_FLOAT32
+ * adds a complex float port per pair of channels, in channel order, named
+ * after the I channel ID with a "_complex" suffix. Float samples are
+ * quantized as they are interleaved, with +/- Full Scale mapped onto the
+ * channel's significant bits, and saturate beyond them; the interleaver
+ * then applies the channel's shift and byte order. Optional triangular
+ * dither of +/- 1 code decorrelates the rounding error from the signal.
+ * getSaturatedSamples() counts saturated samples, including NaN inputs,
+ * which are output as the centre code. The format can only be changed
+ * while the block is inactive, but Full Scale and Dither take effect from
+ * the next push.
+ *
+ * With Max Buffer Size set, the buffer size adapts to the stream between
+ * Min Buffer Size, or Buffer Size if 0, and Max Buffer Size. Pushes are
+ * judged in windows of 16. A window in which the kernel queue ran dry
+ * before a push, or which saw more than one interval between pushes over
+ * twice their mean, doubles the buffer size, and once that is at its
+ * maximum, adds a kernel buffer, up to Max Kernel Buffers. Eight calm
+ * windows in a row, with more than two buffers still queued at every push,
+ * undo one step. The kernel queue is tracked from the device's
+ * "sampling_frequency" attribute; without it, the buffer size stays fixed.
+ * libiio can't resize a buffer, so each step stops pushing until the kernel
+ * queue has played out, then recreates the buffer, which leaves one gap in
+ * the output instead of cutting off queued samples. getDroppedSamples()
+ * counts any samples the queue estimate says were still lost.
+ * getBufferSize() and getKernelBuffers() report the current sizes, which
+ * carry over to the next activation.
+ *
  * |category /IIO
  * |category /Sinks
  * |keywords iio industrial io adc sdr
@@ -48,24 +170,209 @@ using json = nlohmann::json;
  * |preview disable
  * |default 2048
  * 
+ * |param attributeCalls[Attribute Calls] If true, register a probe and a
+ * setter for every device and channel attribute.
+ * |preview disable
+ * |widget ToggleSwitch(on=True,off=False)
+ * |default true
+ *
+ * |param watchAttributes[Watch Attributes] The paths of attributes to watch
+ * for changes.
+ * |preview disable
+ * |default []
+ *
+ * |param watchInterval[Watch Interval] The interval in seconds between
+ * polls of the watched attributes.
+ * |units seconds
+ * |preview disable
+ * |default 1.0
+ *
+ * |param warmRestart[Warm Restart] If true, keep the buffer allocated
+ * between activations.
+ * |preview disable
+ * |widget ToggleSwitch(on=True,off=False)
+ * |default false
+ *
+ * |param drainTimeout[Drain Timeout] The longest time in seconds to wait
+ * on deactivation for the kernel queue to play out, or 0 to drop it.
+ * |units seconds
+ * |preview disable
+ * |default 0.1
+ *
+ * |param calibration[Calibration] A JSON calibration object or file path,
+ * or empty for none.
+ * |preview disable
+ * |default ""
+ *
+ * |param inputFormat[Input Format] The sample type taken by the input ports.
+ * |option [Device] "DEVICE"
+ * |option [Float32] "FLOAT32"
+ * |option [Complex Float32] "COMPLEX_FLOAT32"
+ * |widget ComboBox(editable=false)
+ * |preview disable
+ * |default "DEVICE"
+ *
+ * |param fullScale[Full Scale] The float sample value mapped to the
+ * channel's full-scale code.
+ * |preview disable
+ * |default 1.0
+ *
+ * |param dither[Dither] Dither float samples as they are quantized.
+ * |option [Disabled] false
+ * |option [Enabled] true
+ * |widget ComboBox(editable=false)
+ * |preview disable
+ * |default false
+ *
+ * |param minBufferSize[Min Buffer Size] The smallest adaptive buffer size,
+ * or 0 for Buffer Size.
+ * |units samples
+ * |preview disable
+ * |default 0
+ *
+ * |param maxBufferSize[Max Buffer Size] The largest adaptive buffer size,
+ * or 0 to keep Buffer Size.
+ * |units samples
+ * |preview disable
+ * |default 0
+ *
+ * |param maxKernelBuffers[Max Kernel Buffers] The most kernel buffers the
+ * adaptive buffer may use, or 0 to keep the device's count.
+ * |preview disable
+ * |default 0
+ *
  * |factory /iio/sink(deviceId, channelIds, enablePorts, bufferSize)
+ * |setter setAttributeCallables(attributeCalls)
+ * |setter setWatchAttributes(watchAttributes)
+ * |setter setWatchInterval(watchInterval)
+ * |setter setWarmRestart(warmRestart)
+ * |setter setDrainTimeout(drainTimeout)
+ * |setter setCalibration(calibration)
+ * |setter setInputFormat(inputFormat)
+ * |setter setFullScale(fullScale)
+ * |setter setDither(dither)
+ * |setter setAdaptiveBuffer(minBufferSize, maxBufferSize, maxKernelBuffers)
  **********************************************************************/
 class IIOSink : public Pothos::Block
 {
 private:
+    typedef std::chrono::steady_clock Clock;
+
+    enum class InputFormat
+    {
+        Device,
+        Float,
+        ComplexFloat
+    };
+
     std::unique_ptr<IIODevice> dev;
     std::unique_ptr<IIOBuffer> buf;
     std::vector<IIOChannel> channels;
+    std::vector<IIOChannel> scanChannels;
+    std::vector<void *> inputs;
+    IIOInterleaver interleaver;
+    IIOCommandQueue commands;
+    std::unique_ptr<IIOAttrWatcher> watcher;
+    IIOAttrIndex attrs;
+    bool attributeCallables;
+    unsigned long long totalSamples;
+    bool warmRestart;
+    size_t activeBufferSize;
+    double sampleRate;
+    Clock::time_point queuedUntil;
+    double drainTimeout;
+    bool draining;
+    unsigned long long flushedSamples;
+    unsigned long long droppedSamples;
+    std::map<std::string, std::string> calibrationSpecs;
+    std::vector<IIOCalibration> calibrations;
+    std::vector<size_t> calibrationPorts;
+    std::vector<std::vector<char>> scratch;
+    std::vector<void *> blockPtrs;
+    InputFormat inputFormat;
+    std::vector<std::string> inputPorts;
+    bool floatPorts;
+    bool complexPorts;
+    double fullScale;
+    bool dither;
+    std::vector<IIOSampleQuantizer> quantizers;
+    unsigned long long saturatedSamples;
+    size_t minBufferSize;
+    size_t maxBufferSize;
+    size_t maxKernelBuffers;
+    IIOBufferTuner tuner;
+    bool tuning;
+    bool retunePending;
+    size_t kernelBuffers;
+    size_t activeKernelBuffers;
     bool enablePorts;
     size_t bufferSize;
+    size_t baseBufferSize;
 public:
     IIOSink(const std::string &deviceId, const std::vector<std::string> &channelIds,
         const bool &enablePorts, const size_t &bufferSize)
-        : enablePorts(enablePorts), bufferSize(bufferSize)
+        : attributeCallables(false), totalSamples(0), warmRestart(false), activeBufferSize(0), sampleRate(0.0),
+        drainTimeout(0.1), draining(false), flushedSamples(0), droppedSamples(0), inputFormat(InputFormat::Device),
+        floatPorts(false), complexPorts(false), fullScale(1.0), dither(false), saturatedSamples(0),
+        minBufferSize(0), maxBufferSize(0), maxKernelBuffers(0), tuning(false), retunePending(false), kernelBuffers(0), activeKernelBuffers(0),
+        enablePorts(enablePorts), bufferSize(bufferSize), baseBufferSize(bufferSize)
     {
         //expose overlay hook
         this->registerCall(this, POTHOS_FCN_TUPLE(IIOSink, overlay));
 
+        //expose on-demand attribute access
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSink, getAttribute));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSink, setAttribute));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSink, getAttributePaths));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSink, setAttributeCallables));
+        this->registerProbe("getAttribute");
+
+        //expose register access
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSink, readRegister));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSink, writeRegister));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSink, registerTransaction));
+        this->registerProbe("readRegister");
+
+        //expose scheduled attribute writes
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSink, scheduleDeviceAttribute));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSink, scheduleChannelAttribute));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSink, clearScheduledAttributes));
+
+        //expose attribute watches
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSink, setWatchAttributes));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSink, setWatchInterval));
+        this->registerSignal("attributesChanged");
+        this->registerSignal("attributeChanged");
+
+        //expose buffer reuse across activations
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSink, setWarmRestart));
+
+        //expose draining
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSink, drain));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSink, setDrainTimeout));
+        this->registerSignal("drained");
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSink, getFlushedSamples));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSink, getDroppedSamples));
+        this->registerProbe("getFlushedSamples");
+        this->registerProbe("getDroppedSamples");
+
+        //expose channel calibration
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSink, setCalibration));
+
+        //expose float input conversion
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSink, setInputFormat));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSink, setFullScale));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSink, setDither));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSink, getSaturatedSamples));
+        this->registerProbe("getSaturatedSamples");
+
+        //expose adaptive buffer sizing
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSink, setAdaptiveBuffer));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSink, getBufferSize));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSink, getKernelBuffers));
+        this->registerProbe("getBufferSize");
+        this->registerProbe("getKernelBuffers");
+
         //get libiio context
         IIOContext& ctx = IIOContext::get();
 
@@ -89,24 +396,7 @@ public:
             throw Pothos::SystemException("IIOSink::IIOSink()", "device not found");
         }
 
-        //set up probes/setters for device attributes 
-        for (auto a : this->dev->attributes())
-        {
-            Pothos::Callable attrGetter(&IIOSink::getDeviceAttribute);
-            Pothos::Callable attrSetter(&IIOSink::setDeviceAttribute);
-            attrGetter.bind(std::ref(*this), 0);
-            attrGetter.bind(a, 1);
-            attrSetter.bind(std::ref(*this), 0);
-            attrSetter.bind(a, 1);
-
-            std::string getDeviceAttrName = "deviceAttribute[" + a.name() + "]";
-            std::string setDeviceAttrName = "setdeviceAttribute[" + a.name() + "]";
-            this->registerCallable(getDeviceAttrName, attrGetter);
-            this->registerCallable(setDeviceAttrName, attrSetter);
-            this->registerProbe(getDeviceAttrName);
-        }
-
-        //set up probes/ports for selected input channels
+        //set up ports for selected input channels
         for (auto c : this->dev->channels())
         {
             if (!c.isOutput())
@@ -121,25 +411,14 @@ public:
             if (c.isScanElement() && this->enablePorts)
             {
                 this->setupInput(c.id(), c.dtype());
-            }
-
-            //set up probes/setters for channel attributes
-            for (auto a : c.attributes())
-            {
-                Pothos::Callable attrGetter(&IIOSink::getChannelAttribute);
-                Pothos::Callable attrSetter(&IIOSink::setChannelAttribute);
-                attrGetter.bind(std::ref(*this), 0);
-                attrGetter.bind(a, 1);
-                attrSetter.bind(std::ref(*this), 0);
-                attrSetter.bind(a, 1);
-
-                std::string getChannelAttrName = "channelAttribute[" + c.id() + "][" + a.name() + "]";
-                std::string setChannelAttrName = "setChannelAttribute[" + c.id() + "][" + a.name() + "]";
-                this->registerCallable(getChannelAttrName, attrGetter);
-                this->registerCallable(setChannelAttrName, attrSetter);
-                this->registerProbe(getChannelAttrName);
+                this->scanChannels.push_back(c);
+                this->inputPorts.push_back(c.id());
             }
         }
+
+        //index attributes for on-demand access
+        this->attrs = IIOAttrIndex(*this->dev, this->channels);
+        this->watcher = std::unique_ptr<IIOAttrWatcher>(new IIOAttrWatcher(*this->dev, this->channels));
     }
 
     std::string overlay(void) const
@@ -204,6 +483,420 @@ public:
         a = value.toString();
     }
 
+    std::string getAttribute(const std::string &path)
+    {
+        return this->attrs.read(path);
+    }
+
+    void setAttribute(const std::string &path, Pothos::Object value)
+    {
+        this->attrs.write(path, value.toString());
+    }
+
+    std::vector<std::string> getAttributePaths(void) const
+    {
+        return this->attrs.paths();
+    }
+
+    void setAttributeCallables(const bool enable)
+    {
+        //callables can't be unregistered, so this only ever adds them
+        if (!enable || this->attributeCallables)
+            return;
+        this->attributeCallables = true;
+        for (const auto &c : this->attrs.callables(*this))
+        {
+            this->registerCallable(c.name, c.call);
+            if (c.probe) this->registerProbe(c.name);
+        }
+    }
+
+    uint32_t readRegister(const uint32_t address)
+    {
+        return this->attrs.readRegister(address);
+    }
+
+    void writeRegister(const uint32_t address, const uint32_t value)
+    {
+        this->attrs.writeRegister(address, value);
+    }
+
+    std::string registerTransaction(const std::string &ops)
+    {
+        return this->attrs.registerTransaction(ops);
+    }
+
+    void scheduleDeviceAttribute(unsigned long long index, const std::string &attr, Pothos::Object value)
+    {
+        this->attrs.deviceAttribute(attr);
+        this->commands.push(IIOCommand{index, "", attr, value.toString()});
+    }
+
+    void scheduleChannelAttribute(unsigned long long index, const std::string &channelId, const std::string &attr, Pothos::Object value)
+    {
+        this->attrs.channelAttribute(channelId, attr);
+        this->commands.push(IIOCommand{index, channelId, attr, value.toString()});
+    }
+
+    void clearScheduledAttributes(void)
+    {
+        this->commands.clear();
+    }
+
+    void setWatchAttributes(const std::vector<std::string> &paths)
+    {
+        if (!this->watcher)
+        {
+            if (paths.empty()) return;
+            throw Pothos::SystemException("IIOSink::setWatchAttributes()", "no device specified");
+        }
+        this->watcher->setAttributes(paths);
+    }
+
+    void setWatchInterval(const double interval)
+    {
+        if (this->watcher)
+        {
+            this->watcher->setInterval(interval);
+        }
+    }
+
+    void emitWatchChanges(void)
+    {
+        std::map<std::string, std::string> changes;
+        if (!this->watcher || !this->watcher->takeChanges(changes))
+            return;
+
+        Pothos::ObjectKwargs data;
+        for (const auto &change : changes)
+        {
+            data[change.first] = Pothos::Object(change.second);
+        }
+        this->emitSignal("attributesChanged", data);
+    }
+
+    void waitWatchChanges(void)
+    {
+        //an idle block waits out its work timeout for watched changes, and
+        //yields so that it keeps being called
+        if (!this->watcher || !this->watcher->isWatching()) return;
+        if (this->watcher->waitChanges(this->workInfo().maxTimeoutNs)) this->emitWatchChanges();
+        this->yield();
+    }
+
+    void issueScheduledAttributes(void)
+    {
+        if (this->commands.empty()) return;
+
+        //a write applies from the sample being played, which is behind
+        //the next push by whatever the kernel still has queued; without a
+        //sample rate that is unknown, and pushes end on each index instead
+        const auto queued = std::min<unsigned long long>(this->queuedSamples(Clock::now()), this->totalSamples);
+        const auto boundary = this->totalSamples - queued;
+        const size_t spacing = this->sampleRate > 0.0 ? this->bufferSize : 1;
+        IIOCommand cmd;
+        while (this->commands.popDue(boundary, spacing, cmd))
+        {
+            Pothos::ObjectKwargs data;
+            data["attribute"] = Pothos::Object(cmd.attribute);
+            if (cmd.channel.empty())
+            {
+                auto a = this->attrs.deviceAttribute(cmd.attribute);
+                a = cmd.value;
+            }
+            else
+            {
+                auto a = this->attrs.channelAttribute(cmd.channel, cmd.attribute);
+                a = cmd.value;
+                data["channel"] = Pothos::Object(cmd.channel);
+            }
+            data["value"] = Pothos::Object(cmd.value);
+            data["requestedIndex"] = Pothos::Object(cmd.index);
+            data["offset"] = Pothos::Object(static_cast<long long>(boundary - cmd.index));
+            this->emitSignal("attributeChanged", data);
+        }
+    }
+
+    void setWarmRestart(const bool warmRestart)
+    {
+        this->warmRestart = warmRestart;
+    }
+
+    void setDrainTimeout(const double timeout)
+    {
+        this->drainTimeout = timeout;
+    }
+
+    unsigned long long getFlushedSamples(void)
+    {
+        return this->flushedSamples;
+    }
+
+    unsigned long long getDroppedSamples(void)
+    {
+        return this->droppedSamples;
+    }
+
+    void pushSamples(const size_t sample_count)
+    {
+        //consume samples
+        this->inputs.clear();
+        for (const auto &name : this->inputPorts)
+        {
+            this->inputs.push_back(this->input(name)->buffer().as<void*>());
+        }
+        if (this->inputFormat == InputFormat::Device && this->calibrationPorts.empty())
+        {
+            this->interleaver(this->inputs.data(), this->buf->start(), sample_count);
+        }
+        else
+        {
+            this->interleaveBlocks(sample_count);
+        }
+        for (const auto &name : this->inputPorts)
+        {
+            this->input(name)->consume(sample_count);
+        }
+
+        //push new samples to iio device
+        this->buf->push(sample_count);
+        this->totalSamples += sample_count;
+
+        //track when the kernel queue will have played out
+        if (this->sampleRate > 0.0)
+        {
+            const auto now = Clock::now();
+            if (now > this->queuedUntil) this->queuedUntil = now;
+            this->queuedUntil += std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(sample_count / this->sampleRate));
+        }
+    }
+
+    size_t inputElements(void)
+    {
+        //ports of the other input formats are left unconnected
+        size_t elements = std::numeric_limits<size_t>::max();
+        for (const auto &name : this->inputPorts)
+        {
+            elements = std::min(elements, this->input(name)->elements());
+        }
+        return this->inputPorts.empty() ? 0 : elements;
+    }
+
+    void interleaveBlocks(const size_t sample_count)
+    {
+        //quantize and predistort cache-sized blocks into scratch arrays, and
+        //interleave each one while it is still hot
+        const auto &layout = this->interleaver.layout();
+        const auto out = static_cast<char *>(this->buf->start());
+        this->blockPtrs.resize(this->scanChannels.size());
+        for (size_t begin = 0; begin < sample_count; begin += convertBlock)
+        {
+            const size_t n = std::min(convertBlock, sample_count - begin);
+            for (size_t c = 0; c < this->blockPtrs.size(); ++c)
+            {
+                if (this->inputFormat == InputFormat::Device)
+                {
+                    this->blockPtrs[c] = static_cast<char *>(this->inputs[c]) + begin * layout[c].length * layout[c].repeat;
+                    continue;
+                }
+
+                //complex samples hold the I channel, then the Q channel
+                const bool complex = this->inputFormat == InputFormat::ComplexFloat;
+                const size_t stride = complex ? 2 : 1;
+                const auto in = static_cast<const float *>(this->inputs[complex ? c / 2 : c]) + begin * stride + (complex ? c % 2 : 0);
+                this->saturatedSamples += this->quantizers[c].quantize(in, stride, this->scratch[c].data(), n);
+                this->blockPtrs[c] = this->scratch[c].data();
+            }
+            for (size_t i = 0; i < this->calibrationPorts.size(); ++i)
+            {
+                const auto c = this->calibrationPorts[i];
+                if (this->blockPtrs[c] != this->scratch[c].data())
+                {
+                    std::memcpy(this->scratch[c].data(), this->blockPtrs[c], n * layout[c].length);
+                }
+                this->calibrations[i].apply(this->scratch[c].data(), n);
+                this->blockPtrs[c] = this->scratch[c].data();
+            }
+            this->interleaver(this->blockPtrs.data(), out + begin * this->interleaver.scanStep(), n);
+        }
+    }
+
+    void setupConversion(void)
+    {
+        const auto &layout = this->interleaver.layout();
+        this->scratch.assign(layout.size(), std::vector<char>());
+        this->quantizers.clear();
+        for (size_t c = 0; c < layout.size(); ++c)
+        {
+            this->scratch[c].resize(convertBlock * layout[c].length * layout[c].repeat);
+            if (this->inputFormat == InputFormat::Device) continue;
+            this->quantizers.push_back(IIOSampleQuantizer(layout[c], this->fullScale, this->dither));
+        }
+    }
+
+    void setInputFormat(const std::string &format)
+    {
+        InputFormat inputFormat;
+        if (format == "DEVICE") inputFormat = InputFormat::Device;
+        else if (format == "FLOAT32") inputFormat = InputFormat::Float;
+        else if (format == "COMPLEX_FLOAT32") inputFormat = InputFormat::ComplexFloat;
+        else throw Pothos::InvalidArgumentException("IIOSink::setInputFormat()", "unknown input format: " + format);
+        if (inputFormat == this->inputFormat) return;
+
+        //ports can't be added to an active block
+        if (this->isActive())
+        {
+            throw Pothos::SystemException("IIOSink::setInputFormat()", "input format can't change while active");
+        }
+        if (inputFormat == InputFormat::ComplexFloat && this->scanChannels.size() % 2 != 0)
+        {
+            throw Pothos::InvalidArgumentException("IIOSink::setInputFormat()", "complex input needs pairs of channels");
+        }
+
+        this->inputPorts.clear();
+        for (size_t c = 0; c < this->scanChannels.size(); ++c)
+        {
+            const auto id = this->scanChannels[c].id();
+            switch (inputFormat)
+            {
+            case InputFormat::Device:
+                this->inputPorts.push_back(id);
+                break;
+            case InputFormat::Float:
+                if (!this->floatPorts) this->setupInput(id + "_float", Pothos::DType("float32"));
+                this->inputPorts.push_back(id + "_float");
+                break;
+            case InputFormat::ComplexFloat:
+                if (c % 2 != 0) break;
+                if (!this->complexPorts) this->setupInput(id + "_complex", Pothos::DType("complex_float32"));
+                this->inputPorts.push_back(id + "_complex");
+                break;
+            }
+        }
+        if (inputFormat == InputFormat::Float) this->floatPorts = true;
+        if (inputFormat == InputFormat::ComplexFloat) this->complexPorts = true;
+        this->inputFormat = inputFormat;
+    }
+
+    void setFullScale(const double fullScale)
+    {
+        if (!(fullScale > 0.0))
+        {
+            throw Pothos::RangeException("IIOSink::setFullScale()", "full scale must be positive");
+        }
+        this->fullScale = fullScale;
+        if (this->buf && this->isActive()) this->setupConversion();
+    }
+
+    void setDither(const bool enable)
+    {
+        this->dither = enable;
+        if (this->buf && this->isActive()) this->setupConversion();
+    }
+
+    unsigned long long getSaturatedSamples(void)
+    {
+        return this->saturatedSamples;
+    }
+
+    void setupCalibration(void)
+    {
+        //a bad correction leaves the current ones in place
+        std::vector<IIOCalibration> calibrations;
+        std::vector<size_t> calibrationPorts;
+        const auto &layout = this->interleaver.layout();
+        for (size_t c = 0; c < layout.size(); ++c)
+        {
+            const auto spec = this->calibrationSpecs.find(this->scanChannels[c].id());
+            if (spec == this->calibrationSpecs.end()) continue;
+            calibrations.push_back(IIOCalibration(layout[c], spec->second, true));
+            calibrationPorts.push_back(c);
+        }
+        this->calibrations.swap(calibrations);
+        this->calibrationPorts.swap(calibrationPorts);
+    }
+
+    void setCalibration(const std::string &calibration)
+    {
+        if (!this->dev) return;
+        auto specs = IIOCalibration::load(calibration, this->dev->id());
+        this->calibrationSpecs.swap(specs);
+
+        //swap corrections between pushes
+        if (!this->buf || !this->isActive()) return;
+        try
+        {
+            this->setupCalibration();
+        }
+        catch (...)
+        {
+            this->calibrationSpecs.swap(specs);
+            throw;
+        }
+    }
+
+    void drain(void)
+    {
+        //work() pushes what is left and reports when it has played out
+        this->draining = true;
+        this->flushedSamples = 0;
+        this->droppedSamples = 0;
+    }
+
+    unsigned long long queuedSamples(const Clock::time_point &t)
+    {
+        //estimate what the kernel queue still holds
+        if (this->sampleRate <= 0.0 || this->queuedUntil <= t) return 0;
+        return static_cast<unsigned long long>(
+            std::chrono::duration<double>(this->queuedUntil - t).count() * this->sampleRate);
+    }
+
+    void workDrain(void)
+    {
+        //the input has run dry; wait out the kernel queue a work timeout at
+        //a time, without a sample rate there is no way to tell
+        const auto now = Clock::now();
+        if (this->queuedUntil > now)
+        {
+            std::this_thread::sleep_until(std::min(this->queuedUntil,
+                now + std::chrono::nanoseconds(this->workInfo().maxTimeoutNs)));
+            if (this->queuedUntil > Clock::now()) return this->yield();
+        }
+        this->draining = false;
+        this->emitSignal("drained", this->flushedSamples);
+    }
+
+    void waitOutQueue(void)
+    {
+        //without a drain() beforehand, this is the whole drain
+        if (!this->draining)
+        {
+            this->flushedSamples = 0;
+            this->droppedSamples = 0;
+        }
+        this->draining = false;
+
+        //input left on the ports can only be consumed by work()
+        this->droppedSamples += this->inputElements();
+
+        //wait for the kernel queue to play out; without a sample rate there
+        //is no way to tell, and the queue is dropped unaccounted for
+        if (this->sampleRate <= 0.0) return;
+        if (this->drainTimeout <= 0.0)
+        {
+            this->droppedSamples += this->queuedSamples(Clock::now());
+            return;
+        }
+        const auto start = Clock::now();
+        const auto initiallyQueued = this->queuedSamples(start);
+        std::this_thread::sleep_until(std::min(this->queuedUntil, start + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(this->drainTimeout))));
+        const auto leftover = this->queuedSamples(Clock::now());
+        this->droppedSamples += leftover;
+        this->flushedSamples += initiallyQueued > leftover ? initiallyQueued - leftover : 0;
+    }
+
     void activate(void)
     {
         if (!this->dev)
@@ -212,7 +905,11 @@ public:
         }
 
         bool haveScanElements = false;
-        if (this->buf) {
+        this->setupTuner();
+
+        //a buffer kept by a warm restart is only reusable as configured
+        if (this->buf && !(this->warmRestart && this->activeBufferSize == this->bufferSize &&
+            this->activeKernelBuffers == this->kernelBuffers)) {
             this->buf.reset();
         }
 
@@ -226,29 +923,149 @@ public:
             }
         }
 
-        //create sample buffer if we've got any scan elements
-        if (haveScanElements && this->enablePorts) {
-            this->buf = std::unique_ptr<IIOBuffer>(new IIOBuffer(std::move(this->dev->createBuffer(this->bufferSize, false))));
-            if (!this->buf)
-            {
-                throw Pothos::SystemException("IIOSink::activate()", "buffer creation failed");
-            }
-            this->buf->setBlockingMode(false);
+        //create sample buffer if we've got any scan elements, unless the
+        //buffer and interleaver from the last activation are reused
+        if (haveScanElements && this->enablePorts && !this->buf) {
+            this->openBuffer();
         }
+
+        if (this->buf) {
+            this->setupConversion();
+            this->setupCalibration();
+        }
+    }
+
+    void openBuffer(void)
+    {
+        if (this->kernelBuffers != 0) this->dev->setKernelBuffersCount(static_cast<unsigned int>(this->kernelBuffers));
+        this->buf = std::unique_ptr<IIOBuffer>(new IIOBuffer(std::move(this->dev->createBuffer(this->bufferSize, false))));
+        if (!this->buf)
+        {
+            throw Pothos::SystemException("IIOSink::activate()", "buffer creation failed");
+        }
+        this->activeBufferSize = this->bufferSize;
+        this->activeKernelBuffers = this->kernelBuffers;
+        this->buf->setBlockingMode(false);
+
+        //the sample rate is only used to track the kernel queue, which
+        //starts out empty
+        this->sampleRate = 0.0;
+        this->queuedUntil = Clock::time_point();
+        try
+        {
+            this->sampleRate = std::stod(this->dev->attributes().at("sampling_frequency").value());
+        }
+        catch (const Pothos::Exception &) {}
+        catch (const std::logic_error &) {}
+
+        //pick the fastest interleave kernel for this channel layout
+        this->interleaver = IIOInterleaver(*this->buf, this->scanChannels);
+    }
+
+    void setAdaptiveBuffer(const size_t minSize, const size_t maxSize, const size_t maxKernelBuffers)
+    {
+        if (maxSize != 0 && maxSize < minSize)
+        {
+            throw Pothos::RangeException("IIOSink::setAdaptiveBuffer()", "max buffer size below min buffer size");
+        }
+        this->minBufferSize = minSize;
+        this->maxBufferSize = maxSize;
+        this->maxKernelBuffers = maxKernelBuffers;
+    }
+
+    size_t getBufferSize(void)
+    {
+        return this->bufferSize;
+    }
+
+    size_t getKernelBuffers(void)
+    {
+        return this->activeKernelBuffers;
+    }
+
+    void setupTuner(void)
+    {
+        this->tuning = this->maxBufferSize != 0;
+        this->retunePending = false;
+        if (!this->tuning)
+        {
+            this->bufferSize = this->baseBufferSize;
+            this->kernelBuffers = 0;
+            return;
+        }
+
+        const size_t minSize = this->minBufferSize ? this->minBufferSize : this->baseBufferSize;
+        this->tuner = IIOBufferTuner(minSize, std::max(this->maxBufferSize, minSize), this->bufferSize,
+            std::min(defaultKernelBuffers, this->maxKernelBuffers), this->maxKernelBuffers);
+        this->bufferSize = this->tuner.bufferSize();
+        this->kernelBuffers = this->tuner.kernelBufferCount();
+    }
+
+    void recordPush(void)
+    {
+        //a queue that ran dry underflowed; one holding more than two
+        //buffers has room to shrink
+        const auto now = Clock::now();
+        const bool tracked = this->sampleRate > 0.0 && this->queuedUntil != Clock::time_point();
+        const double queued = tracked ? std::chrono::duration<double>(this->queuedUntil - now).count() * this->sampleRate : 0.0;
+        this->tuner.record(tracked && queued <= 0.0, tracked && queued > 2.0 * this->bufferSize);
+    }
+
+    void workRetune(void)
+    {
+        //libiio can't resize a buffer, and the kernel queue goes with it,
+        //so stop pushing and wait it out a work timeout at a time
+        const auto now = Clock::now();
+        if (this->queuedUntil > now)
+        {
+            std::this_thread::sleep_until(std::min(this->queuedUntil,
+                now + std::chrono::nanoseconds(this->workInfo().maxTimeoutNs)));
+            if (this->queuedUntil > Clock::now()) return this->yield();
+        }
+
+        //count whatever the estimate says is still queued as lost
+        this->droppedSamples += this->queuedSamples(Clock::now());
+        this->retunePending = false;
+        this->buf.reset();
+        this->bufferSize = this->tuner.bufferSize();
+        this->kernelBuffers = this->tuner.kernelBufferCount();
+        this->openBuffer();
     }
 
     void deactivate(void)
     {
         if (this->buf) {
+            this->waitOutQueue();
+        }
+        if (this->buf && !this->warmRestart) {
             this->buf.reset();
         }
+        this->commands.clear();
+        this->totalSamples = 0;
     }
 
     void work(void)
     {
-        auto sample_count = this->workInfo().minInElements;
- 
+        //report watched attribute changes
+        this->emitWatchChanges();
+
+        //a push can't be larger than the buffer itself
+        auto sample_count = std::min(this->inputElements(), this->bufferSize);
+
         if (this->buf) {
+            //issue scheduled writes due before the next push; without a
+            //sample rate, end the push where the next one is due
+            this->issueScheduledAttributes();
+            if (!this->commands.empty() && this->sampleRate <= 0.0)
+            {
+                sample_count = std::min<unsigned long long>(sample_count, this->commands.nextIndex() - this->totalSamples);
+            }
+        }
+
+        if (this->buf && this->retunePending) {
+            this->workRetune();
+        }
+        else if (this->buf && sample_count > 0) {
             #ifndef _MSC_VER
             //wait for samples
             struct pollfd pfd = {
@@ -271,20 +1088,20 @@ public:
             else if (ret == 0)
                 return this->yield();
 
-            //consume samples
-            for (auto c : this->channels)
-            {
-                if (c.isScanElement()) {
-                    auto inputPort = this->input(c.id());
-                    auto inputBuffer = inputPort->buffer();
-
-                    c.write(*this->buf, inputBuffer.as<void*>(), sample_count);
-                    inputPort->consume(sample_count);
-                }
-            }
-
-            //push new samples to iio device
-            this->buf->push(sample_count);
+            //the kernel queue can only be waited out with a sample rate
+            const bool tracked = this->tuning && this->sampleRate > 0.0;
+            if (tracked) this->recordPush();
+            this->pushSamples(sample_count);
+            if (this->draining) this->flushedSamples += sample_count;
+            if (tracked) this->retunePending = this->tuner.retune();
+        }
+        else if (this->buf && this->draining && this->inputElements() == 0)
+        {
+            this->workDrain();
+        }
+        else
+        {
+            this->waitWatchChanges();
         }
     }
 };
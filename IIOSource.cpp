@@ -9,20 +9,281 @@
 #include <winsock2.h>
 #endif
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <map>
 #include <memory>
+#include <set>
+#include <stdexcept>
 #include <string>
+#include <utility>
 #include <cstring>
 #include <vector>
 #include "IIOSupport.hpp"
+#include "IIOKernels.hpp"
+#include "IIOCommandQueue.hpp"
+#include "IIOAttrWatcher.hpp"
+#include "IIOAttrIndex.hpp"
+#include "IIOBufferTuner.hpp"
+#include "IIOCalibration.hpp"
+#include "IIOCapture.hpp"
+#include "IIODigital.hpp"
+#include "IIOMonitor.hpp"
+#include "IIOReactor.hpp"
+#include "IIOWorkerPool.hpp"
 
 #include <json.hpp>
 using json = nlohmann::json;
 
+//the longest activate() spends discarding stale buffers when reusing a
+//warm buffer, in seconds
+static const double maxFlushTime = 0.005;
+
+//the number of samples deinterleaved at once when feeding the trigger or
+//the monitoring taps, small enough to stay in cache
+static const size_t tapBlock = 4096;
+
+//the most bursts that scope mode holds for downstream
+static const size_t maxStagedBursts = 8;
+
+//the kernel buffer count libiio allocates by default
+static const size_t defaultKernelBuffers = 4;
+
 /***********************************************************************
  * |PothosDoc IIO Source
  *
  * The IIO source forwards an IIO input device to an output sample stream.
  *
+ * Whenever a device or channel attribute is set through the block, an
+ * "attributeChanged" label is posted at the first sample captured after the
+ * write, behind the samples held in the DROP_OLDEST ring and, on devices
+ * that report their buffer fill, those already queued in the kernel. On
+ * other devices the label marks the next delivery, and can be early by up
+ * to the kernel queue. In scope mode it marks the next delivered sample.
+ * Device attribute changes are labelled on every output port, and channel
+ * attribute changes on that channel's port only. The label data holds the
+ * "attribute" name, the new "value" as read back from the device, and for
+ * channel attributes the "channel" ID.
+ *
+ * Attribute writes can also be scheduled at a sample index of the output
+ * stream, counted from zero at activation, with scheduleDeviceAttribute()
+ * and scheduleChannelAttribute(). Each write is issued between refills, at
+ * the buffer boundary closest to the requested index, so the achieved
+ * timing is bounded by the buffer size. Its attributeChanged label also
+ * holds the "requestedIndex" and the achieved "offset" in samples, counting
+ * the samples already queued in the kernel on devices that report their
+ * buffer fill. On other devices the queued samples are unknown, and the
+ * true offset can be later by up to the kernel buffer count times the
+ * buffer size. Samples captured while the write itself is in progress
+ * blur the boundary further, as do dropped samples.
+ * Scheduled writes still pending when the block deactivates are dropped.
+ *
+ * Attributes are named by path: "attr" for a device attribute, and
+ * "channelId/attr" for a channel attribute. They can always be accessed on
+ * demand through getAttribute(path) and setAttribute(path, value), and
+ * getAttributePaths() lists them. When Attribute Calls is enabled, a
+ * deviceAttribute[attr]/channelAttribute[channelId][attr] probe and setter
+ * is also registered for every attribute; disabling it skips listing the
+ * attributes at construction, which only matters on devices with many
+ * attributes. Attribute Calls defaults to on in the block factory, but a
+ * block constructed directly starts with it off, so code that constructs
+ * one and relies on the deviceAttribute[attr] probes must call
+ * setAttributeCallables(true) first.
+ *
+ * Device debug attributes are also available on demand, named
+ * "debug/attr". Device registers can be accessed with readRegister(address)
+ * and writeRegister(address, value), or in a batch with
+ * registerTransaction(ops). In that case ops is a JSON array of
+ * {"address": a} reads and {"address": a, "value": v} writes, which are
+ * applied in order, and the result is a JSON array holding the value read
+ * or written by each operation. A transaction is still one libiio register
+ * read or write per operation; it only saves the round trip through the
+ * block call for each one. Malformed ops are rejected before any
+ * operation is applied. Debug attributes are only listed on first use.
+ *
+ * Attributes listed in Watch Attributes are polled in bulk on a background
+ * thread every Watch Interval. Changed values are reported through the
+ * attributesChanged signal as a map from attribute path to new value.
+ * Every watched attribute is reported once with its initial value.
+ * Notifications are emitted from the block's work() calls. While the block
+ * has nothing to stream, work() waits up to the work timeout for changes
+ * and yields, so that they are still reported. An inactive block keeps its
+ * changes until it is activated.
+ *
+ * Watermark sets the device's buffer watermark, the number of queued
+ * samples at which the kernel wakes the block. A watermark below the
+ * buffer size wakes the block once that many samples are queued, and the
+ * refill returns them without waiting for the rest, so data is delivered
+ * in watermark-sized chunks with lower latency. Refills never block the
+ * block's thread. Drivers that only hand over whole DMA blocks still
+ * deliver full buffers. On devices that report their
+ * kernel buffer fill, the block refills back to back without waiting while
+ * whole buffers are queued, and getDataAvailable() returns the number of
+ * queued samples.
+ *
+ * Backpressure sets what happens when downstream can't take another buffer.
+ * BLOCK stops reading from the device until it can, leaving the kernel to
+ * overflow, and getStalls() counts how often that happened. DROP_NEWEST
+ * keeps reading and discards each buffer that can't be delivered.
+ * DROP_OLDEST keeps the most recent Ring Depth buffers in the block, and
+ * delivers them first when downstream catches up, discarding older ones.
+ * Dropped samples are counted by getDroppedSamples(), and a "dropped" label
+ * holding the number of samples lost is posted at the first sample
+ * delivered after each gap.
+ *
+ * With Acquisition Samples set, the source captures exactly that many
+ * samples per output port and then stops. Each capture creates a fresh
+ * buffer, so streaming starts when the capture is armed, and then writes
+ * the optional Acquisition Start attribute, given as "path=value", to
+ * trigger the device. The last sample of a capture is labelled "rxEnd",
+ * with the capture length as data, and the buffer is released until the
+ * next capture. Activation arms the first capture, and arm() starts each
+ * following one, restarting any capture in progress. isAcquiring() tells
+ * whether a capture is still running. Setting Acquisition Samples to 0
+ * while active ends any capture and resumes continuous streaming. Under the
+ * DROP_NEWEST and DROP_OLDEST policies a capture counts delivered samples,
+ * so it can span more than that many device samples; each gap is marked
+ * with a "dropped" label as in continuous streaming.
+ *
+ * In Scope Mode the source keeps reading the device into an in-memory
+ * history of Pre Trigger samples, and outputs nothing until a trigger, so
+ * only the windows around triggers enter the graph. A trigger is a crossing
+ * of Trigger Level, in raw codes, on Trigger Channel, or a call to the
+ * trigger() slot. Trigger Edge picks rising or falling crossings or both,
+ * Trigger Hysteresis is how far the signal must first move away from the
+ * level to rearm the trigger, and Trigger Holdoff is the number of samples
+ * after a trigger during which crossings are ignored. Changing any of them
+ * while active rebuilds the trigger, which disarms it and ends any holdoff
+ * in progress. The trigger channel
+ * is scanned block by block during the deinterleave, and blocks that can't
+ * contain a crossing are skipped after a vectorized minimum/maximum check.
+ *
+ * Each trigger outputs one burst of the pre-trigger history followed by
+ * Post Trigger samples, starting at the triggering sample. A trigger within
+ * a burst extends it by Post Trigger samples from that trigger. Triggering
+ * samples are labelled "trigger", with the trigger channel ID or "message"
+ * as data, and the last sample of each burst is labelled "rxEnd", with the
+ * burst length as data. getBursts() counts bursts. While a backlog of bursts
+ * waits on downstream, further triggers are dropped and counted by
+ * getMissedTriggers(). Up to 8 bursts are held, and a burst kept open by
+ * retriggers beyond that room is cut short. Scope mode ignores the
+ * backpressure policy, and can't be combined with finite acquisitions.
+ * Scope settings apply immediately, also while active; changing Scope Mode,
+ * Pre Trigger or Post Trigger drops the bursts still held.
+ *
+ * With Stats Interval set, the source computes the minimum, maximum, mean,
+ * RMS and number of full-scale samples of every channel, in raw codes, as
+ * it deinterleaves. Every Stats Interval they are emitted through the
+ * statsChanged signal, as a map from channel ID to a map of "count", "min",
+ * "max", "mean", "rms" and "clipped", and getStats() returns the latest
+ * ones. Statistics cover the delivered samples, or in scope mode every
+ * sample read from the device. Channels with repeated or odd-sized samples
+ * are left out.
+ *
+ * With Envelope Decimation set, every channel gets a second output port,
+ * named after the channel ID with an "_envelope" suffix, for display
+ * clients. Each of its elements is the minimum and maximum raw code of one
+ * run of Envelope Decimation samples, computed on the samples as they are
+ * deinterleaved, so that the full rate port can stay unconnected. Like the
+ * statistics, envelopes cover the delivered samples, or in scope mode every
+ * sample read from the device. Points that don't fit the envelope port are
+ * dropped rather than holding up the data path. The ports are created by
+ * the first non-zero setting, which must come before activation; the factor
+ * itself can be changed at any time.
+ *
+ * With Code Histogram enabled, the source counts how often each raw code of
+ * every channel occurs, as it deinterleaves, for ENOB and clipping analysis.
+ * getHistogram() returns a map from channel ID to a map of "first", the
+ * code of the first bin, "step", the number of codes per bin, and "counts",
+ * the count of each bin since activation, the last resetHistogram(), or
+ * enabling Code Histogram while active.
+ * There is one bin per code of the channel's significant bits, up to 16
+ * bits; wider channels are binned by their top 16 bits. Histograms cover
+ * the same samples as the statistics.
+ *
+ * Calibration corrects the raw codes of chosen channels as they are
+ * deinterleaved, so that they come out in the device's sample type without
+ * a separate correction pass downstream. It is a JSON object, or the path
+ * of a file holding one, keyed by device ID and then channel ID, whose
+ * entries are {"gain": g, "offset": o}, {"polynomial": [c0, c1, ...]} or
+ * {"table": [...]}, a corrected code for each code from the lowest.
+ * Corrected codes saturate at the channel's full scale. Statistics and
+ * histograms see the raw codes, and triggers the corrected ones. A new
+ * calibration takes effect from the next buffer.
+ *
+ * For receivers, DC Channels lists the channel IDs whose tracked DC offset
+ * is removed, and IQ Channels lists pairs of I and Q channel IDs whose gain
+ * and phase imbalance is corrected by replacing Q with the combination of
+ * Q and I that matches the power of I and is orthogonal to it. Both track
+ * their estimates over each block of samples with a time constant of
+ * Correction Time samples, and apply them in the same pass, after the
+ * calibration, keeping the device sample type. getDCOffsets() returns the
+ * offset removed from each channel, in codes, and getIQImbalance() returns
+ * a map from "I/Q" channel ID pairs to a map of the "amplitude" ratio of Q
+ * to I and the "phase" error of Q, in radians. Changing any of these
+ * settings while active takes effect from the next buffer, and restarts
+ * the estimates.
+ *
+ * Digital Mode unpacks chosen bits of Digital Channel, for logic analyzer
+ * style devices that pack many lines into one scan element. Bits counts
+ * from the least significant bit after the channel's shift, and defaults
+ * to all of its significant bits. BITS outputs each bit as 0 or 1 on a
+ * uint8 port named after the channel ID with a "_bit<N>" suffix. EDGES
+ * outputs only the transitions on a port named after the channel ID with
+ * an "_edges" suffix, whose elements are {index, value} uint64 pairs,
+ * where index counts the delivered samples since activation and value
+ * holds the chosen bits in place; the first sample is always reported.
+ * The channel's own port still carries the packed samples. The ports are
+ * created by the first setting that needs them, which must come before
+ * activation.
+ *
+ * With Deinterleave Threads above 1, each buffer is split into ranges of
+ * scans that are deinterleaved in parallel on a pool of that many threads,
+ * counting the block's own thread, and produced once all of them finish.
+ * This helps very wide devices, where one core can't keep up, until memory
+ * bandwidth runs out. Buffers are only split when no trigger, tap,
+ * correction or digital expansion needs to see the samples in order, and
+ * when they hold at least two ranges of 4096 scans. Changing the thread
+ * count while active takes effect from the next buffer.
+ *
+ * With Shared Reactor enabled, the buffer's file descriptor is registered
+ * with one process-wide epoll thread instead of being polled by the block.
+ * A block whose buffer isn't ready returns from work() at once, and the
+ * reactor posts to its reactorReady slot when the buffer becomes readable,
+ * which is the only thing that wakes it. Many blocks streaming from
+ * low-rate devices then share one waiting thread instead of each sleeping
+ * in poll() for up to the work timeout. A ready block still costs one
+ * slot message per buffer, so a block that streams continuously gains
+ * nothing. Only supported on Linux.
+ *
+ * With Max Buffer Size set, the buffer size adapts to the stream between
+ * Min Buffer Size, or Buffer Size if 0, and Max Buffer Size. Refills are
+ * judged in windows of 16. A window in which the source stalled or dropped
+ * samples, found another whole buffer already queued in the kernel, or
+ * saw more than one interval between refills over twice their mean,
+ * doubles the buffer size, and once that is at its maximum, adds a kernel buffer,
+ * up to Max Kernel Buffers. Eight calm windows in a row, with room
+ * downstream for more than two buffers after every refill, undo one step.
+ * libiio can't resize a buffer, so each step recreates it between refills,
+ * after any DROP_OLDEST ring has drained, and samples queued in the kernel
+ * at that point are counted as dropped. The ring buffers are allocated for
+ * the largest size up front. getBufferSize() and getKernelBuffers() report
+ * the current sizes, which carry over to the next activation. Sample and
+ * digital output buffers are allocated to hold Max Buffer Size samples, so
+ * Max Buffer Size must be set before the topology is committed. Not used
+ * in scope mode or for finite acquisitions.
+ *
+ * With Warm Restart enabled, the buffer is kept allocated when the block
+ * deactivates, and reused by the next activation if its configuration is
+ * unchanged, which skips kernel buffer allocation and DMA setup. libiio
+ * can't disable a buffer without freeing it, so the device keeps streaming
+ * while the block is inactive, and samples captured meanwhile are
+ * discarded on activation. Discarding stops after 5 ms, so that a fast
+ * device can't stall activation, and may leave some stale samples.
+ *
  * |category /IIO
  * |category /Sources
  * |keywords iio industrial io adc sdr
@@ -48,24 +309,475 @@ using json = nlohmann::json;
  * |preview disable
  * |default 2048
  * 
+ * |param attributeCalls[Attribute Calls] If true, register a probe and a
+ * setter for every device and channel attribute.
+ * |preview disable
+ * |widget ToggleSwitch(on=True,off=False)
+ * |default true
+ *
+ * |param watchAttributes[Watch Attributes] The paths of attributes to watch
+ * for changes.
+ * |preview disable
+ * |default []
+ *
+ * |param watchInterval[Watch Interval] The interval in seconds between
+ * polls of the watched attributes.
+ * |units seconds
+ * |preview disable
+ * |default 1.0
+ *
+ * |param watermark[Watermark] The number of queued samples at which the
+ * block is woken, or 0 to keep the device's default. Changes take effect
+ * at the next activation.
+ * |units samples
+ * |preview disable
+ * |default 0
+ *
+ * |param warmRestart[Warm Restart] If true, keep the buffer allocated
+ * between activations.
+ * |preview disable
+ * |widget ToggleSwitch(on=True,off=False)
+ * |default false
+ *
+ * |param backpressure[Backpressure] What to do when downstream is full.
+ * |option [Block] "BLOCK"
+ * |option [Drop Newest] "DROP_NEWEST"
+ * |option [Drop Oldest] "DROP_OLDEST"
+ * |widget ComboBox(editable=false)
+ * |preview disable
+ * |default "BLOCK"
+ *
+ * |param ringDepth[Ring Depth] The number of buffers kept by DROP_OLDEST.
+ * |units buffers
+ * |preview disable
+ * |default 4
+ *
+ * |param acquisitionSamples[Acquisition Samples] The number of samples to
+ * capture each time the source is armed, or 0 to stream continuously.
+ * |units samples
+ * |preview disable
+ * |default 0
+ *
+ * |param acquisitionStart[Acquisition Start] An attribute write that starts
+ * each capture, as "path=value", or empty for none.
+ * |preview disable
+ * |default ""
+ *
+ * |param scopeMode[Scope Mode] If true, only output bursts around triggers.
+ * |preview disable
+ * |widget ToggleSwitch(on=True,off=False)
+ * |default false
+ *
+ * |param preTrigger[Pre Trigger] The number of samples before each trigger
+ * to output in scope mode.
+ * |units samples
+ * |preview disable
+ * |default 1024
+ *
+ * |param postTrigger[Post Trigger] The number of samples from each trigger
+ * onwards to output in scope mode.
+ * |units samples
+ * |preview disable
+ * |default 1024
+ *
+ * |param triggerChannel[Trigger Channel] The ID of the channel to watch for
+ * level crossings in scope mode, or empty to only trigger on messages.
+ * |preview disable
+ * |default ""
+ *
+ * |param triggerLevel[Trigger Level] The level in raw codes that triggers
+ * a burst when crossed.
+ * |preview disable
+ * |default 0.0
+ *
+ * |param triggerEdge[Trigger Edge] The direction of crossings that trigger.
+ * |option [Rising] "RISING"
+ * |option [Falling] "FALLING"
+ * |option [Both] "BOTH"
+ * |widget ComboBox(editable=false)
+ * |preview disable
+ * |default "RISING"
+ *
+ * |param triggerHysteresis[Trigger Hysteresis] How far past the level, in
+ * raw codes, the signal must move before the trigger rearms.
+ * |preview disable
+ * |default 0.0
+ *
+ * |param triggerHoldoff[Trigger Holdoff] The number of samples after a
+ * trigger during which crossings are ignored.
+ * |units samples
+ * |preview disable
+ * |default 0
+ *
+ * |param statsInterval[Stats Interval] The interval in seconds between
+ * channel statistics reports, or 0 to disable them.
+ * |units seconds
+ * |preview disable
+ * |default 0.0
+ *
+ * |param codeHistogram[Code Histogram] Count the raw codes of every channel.
+ * |option [Disabled] false
+ * |option [Enabled] true
+ * |widget ComboBox(editable=false)
+ * |preview disable
+ * |default false
+ *
+ * |param calibration[Calibration] A JSON calibration object or file path,
+ * or empty for none.
+ * |preview disable
+ * |default ""
+ *
+ * |param dcChannels[DC Channels] The IDs of channels to correct for DC
+ * offset.
+ * |preview disable
+ * |default []
+ *
+ * |param iqChannels[IQ Channels] Pairs of I and Q channel IDs to correct
+ * for I/Q imbalance, as [I, Q, ...].
+ * |preview disable
+ * |default []
+ *
+ * |param correctionTime[Correction Time] The time constant of the DC and
+ * I/Q imbalance estimates.
+ * |units samples
+ * |preview disable
+ * |default 65536.0
+ *
+ * |param envelopeDecimation[Envelope Decimation] The number of samples
+ * reduced to each min/max envelope point, or 0 for no envelope ports.
+ * |units samples
+ * |preview disable
+ * |default 0
+ *
+ * |param deinterleaveThreads[Deinterleave Threads] The number of threads
+ * that deinterleave each buffer, or 0 or 1 for the block's own thread.
+ * |preview disable
+ * |default 0
+ *
+ * |param digitalMode[Digital Mode] How to unpack the bits of Digital Channel.
+ * |option [Off] "OFF"
+ * |option [Bits] "BITS"
+ * |option [Edges] "EDGES"
+ * |widget ComboBox(editable=false)
+ * |preview disable
+ * |default "OFF"
+ *
+ * |param digitalChannel[Digital Channel] The ID of the channel to unpack.
+ * |preview disable
+ * |default ""
+ *
+ * |param digitalBits[Digital Bits] The bits to unpack, or empty for all.
+ * |preview disable
+ * |default []
+ *
+ * |param reactor[Shared Reactor] Wait for buffers on the shared epoll
+ * thread rather than polling them from the block.
+ * |preview disable
+ * |widget ToggleSwitch(on=True,off=False)
+ * |default false
+ *
+ * |param minBufferSize[Min Buffer Size] The smallest adaptive buffer size,
+ * or 0 for Buffer Size.
+ * |units samples
+ * |preview disable
+ * |default 0
+ *
+ * |param maxBufferSize[Max Buffer Size] The largest adaptive buffer size,
+ * or 0 to keep Buffer Size.
+ * |units samples
+ * |preview disable
+ * |default 0
+ *
+ * |param maxKernelBuffers[Max Kernel Buffers] The most kernel buffers the
+ * adaptive buffer may use, or 0 to keep the device's count.
+ * |preview disable
+ * |default 0
+ *
  * |factory /iio/source(deviceId, channelIds, enablePorts, bufferSize)
+ * |setter setAttributeCallables(attributeCalls)
+ * |setter setWatchAttributes(watchAttributes)
+ * |setter setWatchInterval(watchInterval)
+ * |setter setWarmRestart(warmRestart)
+ * |setter setWatermark(watermark)
+ * |setter setBackpressure(backpressure)
+ * |setter setRingDepth(ringDepth)
+ * |setter setAcquisitionSamples(acquisitionSamples)
+ * |setter setAcquisitionStart(acquisitionStart)
+ * |setter setScopeMode(scopeMode)
+ * |setter setPreTrigger(preTrigger)
+ * |setter setPostTrigger(postTrigger)
+ * |setter setTriggerChannel(triggerChannel)
+ * |setter setTriggerLevel(triggerLevel)
+ * |setter setTriggerEdge(triggerEdge)
+ * |setter setTriggerHysteresis(triggerHysteresis)
+ * |setter setTriggerHoldoff(triggerHoldoff)
+ * |setter setStatsInterval(statsInterval)
+ * |setter setEnvelopeDecimation(envelopeDecimation)
+ * |setter setDeinterleaveThreads(deinterleaveThreads)
+ * |setter setDigitalExpansion(digitalMode, digitalChannel, digitalBits)
+ * |setter setReactor(reactor)
+ * |setter setAdaptiveBuffer(minBufferSize, maxBufferSize, maxKernelBuffers)
+ * |setter setCodeHistogram(codeHistogram)
+ * |setter setCalibration(calibration)
+ * |setter setDCChannels(dcChannels)
+ * |setter setIQChannels(iqChannels)
+ * |setter setCorrectionTime(correctionTime)
  **********************************************************************/
 class IIOSource : public Pothos::Block
 {
 private:
+    typedef std::chrono::steady_clock Clock;
+
+    enum class Backpressure
+    {
+        Block,
+        DropNewest,
+        DropOldest
+    };
+
+    enum class DigitalMode
+    {
+        Off,
+        Bits,
+        Edges
+    };
+
+    struct RingSlot
+    {
+        RingSlot(void) : count(0) {}
+        std::vector<char> data;
+        size_t count;
+    };
+
     std::unique_ptr<IIODevice> dev;
     std::unique_ptr<IIOBuffer> buf;
     std::vector<IIOChannel> channels;
+    std::vector<IIOChannel> scanChannels;
+    std::vector<void *> outputs;
+    IIODeinterleaver deinterleaver;
+    std::vector<std::pair<std::string, Pothos::Label>> pendingLabels;
+    IIOCommandQueue commands;
+    std::unique_ptr<IIOAttrWatcher> watcher;
+    IIOAttrIndex attrs;
+    bool attributeCallables;
+    unsigned long long totalSamples;
+    bool warmRestart;
+    size_t activeBufferSize;
+    size_t activeWatermark;
+    size_t watermark;
+    bool trackBacklog;
+    size_t backlog;
+    Backpressure policy;
+    std::vector<RingSlot> ring;
+    size_t ringHead;
+    size_t ringSize;
+    bool stalled;
+    unsigned long long stalls;
+    unsigned long long droppedSamples;
+    unsigned long long pendingDrops;
+    unsigned long long acquisitionSamples;
+    std::string acquisitionStart;
+    unsigned long long captureLength;
+    unsigned long long captureRemaining;
+    bool canStream;
+    bool scopeMode;
+    size_t preTrigger;
+    size_t postTrigger;
+    std::string triggerChannel;
+    double triggerLevel;
+    size_t triggerPort;
+    IIOLevelTrigger levelTrigger;
+    bool messageTriggered;
+    std::vector<std::vector<char>> scratch;
+    std::vector<void *> scratchPtrs;
+    IIOSampleFifo history;
+    IIOSampleFifo staged;
+    std::deque<std::pair<unsigned long long, Pothos::Label>> stagedLabels;
+    unsigned long long postRemaining;
+    unsigned long long burstStart;
+    unsigned long long bursts;
+    unsigned long long missedTriggers;
+    IIOLevelTrigger::Edge triggerEdge;
+    double triggerHysteresis;
+    unsigned long long triggerHoldoff;
+    std::vector<size_t> sampleSizes;
+    std::vector<void *> blockPtrs;
+    double statsInterval;
+    std::vector<IIOChannelStats> stats;
+    std::vector<size_t> statsPorts;
+    Clock::time_point nextStats;
+    Pothos::ObjectKwargs lastStats;
+    size_t envelopeDecimation;
+    bool envelopeOutputs;
+    std::vector<IIOEnvelope> envelopes;
+    std::vector<size_t> envelopePorts;
+    std::vector<std::vector<char>> envelopePoints;
+    bool codeHistogram;
+    std::vector<IIOCodeHistogram> histograms;
+    std::vector<size_t> histogramPorts;
+    std::map<std::string, std::string> calibrationSpecs;
+    std::vector<IIOCalibration> calibrations;
+    std::vector<size_t> calibrationPorts;
+    std::vector<std::string> dcChannels;
+    std::vector<std::string> iqChannels;
+    double correctionTime;
+    std::vector<IIODCBlocker> dcBlockers;
+    std::vector<size_t> dcPorts;
+    std::vector<IIOIQBalancer> iqBalancers;
+    std::vector<std::pair<size_t, size_t>> iqPorts;
+    DigitalMode digitalMode;
+    std::string digitalChannel;
+    std::vector<unsigned int> digitalBits;
+    std::set<std::string> digitalOutputs;
+    std::vector<std::string> digitalPorts;
+    size_t digitalPort;
+    IIOBitExpander expander;
+    std::vector<uint8_t *> bitPtrs;
+    size_t edgeCount;
+    size_t deinterleaveThreads;
+    std::unique_ptr<IIOWorkerPool> pool;
+    std::vector<IIODeinterleaveRange> ranges;
+    std::vector<std::function<void(void)>> jobs;
+    bool reactor;
+    std::unique_ptr<IIOReactorWaiter> waiter;
+    size_t minBufferSize;
+    size_t maxBufferSize;
+    size_t maxKernelBuffers;
+    IIOBufferTuner tuner;
+    bool tuning;
+    size_t kernelBuffers;
+    size_t activeKernelBuffers;
+    unsigned long long tunedLosses;
     bool enablePorts;
     size_t bufferSize;
+    size_t baseBufferSize;
 public:
     IIOSource(const std::string &deviceId, const std::vector<std::string> &channelIds,
         const bool &enablePorts, const size_t &bufferSize)
-        : enablePorts(enablePorts), bufferSize(bufferSize)
+        : attributeCallables(false), totalSamples(0), warmRestart(false), activeBufferSize(0), activeWatermark(0),
+        watermark(0), trackBacklog(false), backlog(0), policy(Backpressure::Block), ring(4), ringHead(0), ringSize(0),
+        stalled(false), stalls(0), droppedSamples(0), pendingDrops(0),
+        acquisitionSamples(0), captureLength(0), captureRemaining(0), canStream(false),
+        scopeMode(false), preTrigger(1024), postTrigger(1024), triggerLevel(0.0), triggerPort(0), messageTriggered(false),
+        postRemaining(0), burstStart(0), bursts(0), missedTriggers(0), triggerEdge(IIOLevelTrigger::Rising),
+        triggerHysteresis(0.0), triggerHoldoff(0), statsInterval(0.0),
+        envelopeDecimation(0), envelopeOutputs(false), codeHistogram(false),
+        correctionTime(65536.0), digitalMode(DigitalMode::Off), digitalPort(0), edgeCount(0),
+        deinterleaveThreads(0), reactor(false), minBufferSize(0), maxBufferSize(0), maxKernelBuffers(0),
+        tuning(false), kernelBuffers(0), activeKernelBuffers(0), tunedLosses(0),
+        enablePorts(enablePorts), bufferSize(bufferSize), baseBufferSize(bufferSize)
     {
         //expose overlay hook
         this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, overlay));
 
+        //expose on-demand attribute access
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, getAttribute));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setAttribute));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, getAttributePaths));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setAttributeCallables));
+        this->registerProbe("getAttribute");
+
+        //expose register access
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, readRegister));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, writeRegister));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, registerTransaction));
+        this->registerProbe("readRegister");
+
+        //expose scheduled attribute writes
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, scheduleDeviceAttribute));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, scheduleChannelAttribute));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, clearScheduledAttributes));
+
+        //expose attribute watches
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setWatchAttributes));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setWatchInterval));
+        this->registerSignal("attributesChanged");
+
+        //expose buffer wakeup controls
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setWatermark));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, getWatermark));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, getDataAvailable));
+        this->registerProbe("getDataAvailable");
+
+        //expose buffer reuse across activations
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setWarmRestart));
+
+        //expose backpressure handling
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setBackpressure));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setRingDepth));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, getStalls));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, getDroppedSamples));
+        this->registerProbe("getStalls");
+        this->registerProbe("getDroppedSamples");
+
+        //expose finite acquisitions
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setAcquisitionSamples));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setAcquisitionStart));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, arm));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, isAcquiring));
+        this->registerProbe("isAcquiring");
+
+        //expose scope mode
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setScopeMode));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setPreTrigger));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setPostTrigger));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setTriggerChannel));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setTriggerLevel));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setTriggerEdge));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setTriggerHysteresis));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setTriggerHoldoff));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, trigger));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, getBursts));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, getMissedTriggers));
+        this->registerSlot("trigger");
+        this->registerProbe("getBursts");
+        this->registerProbe("getMissedTriggers");
+
+        //expose channel statistics
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setStatsInterval));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, getStats));
+        this->registerProbe("getStats");
+        this->registerSignal("statsChanged");
+
+        //expose min/max envelope ports
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setEnvelopeDecimation));
+
+        //expose raw code histograms
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setCodeHistogram));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, getHistogram));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, resetHistogram));
+        this->registerProbe("getHistogram");
+
+        //expose channel calibration
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setCalibration));
+
+        //expose DC and I/Q imbalance correction
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setDCChannels));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setIQChannels));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setCorrectionTime));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, getDCOffsets));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, getIQImbalance));
+        this->registerProbe("getDCOffsets");
+        this->registerProbe("getIQImbalance");
+
+        //expose digital channel expansion
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setDigitalExpansion));
+
+        //expose parallel deinterleaving
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setDeinterleaveThreads));
+
+        //expose the shared reactor, which wakes the block through a slot
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setReactor));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, reactorReady));
+        this->registerSlot("reactorReady");
+
+        //expose adaptive buffer sizing
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, setAdaptiveBuffer));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, getBufferSize));
+        this->registerCall(this, POTHOS_FCN_TUPLE(IIOSource, getKernelBuffers));
+        this->registerProbe("getBufferSize");
+        this->registerProbe("getKernelBuffers");
+
         //get libiio context
         IIOContext& ctx = IIOContext::get();
 
@@ -89,24 +801,7 @@ public:
             throw Pothos::SystemException("IIOSource::IIOSource()", "device not found");
         }
 
-        //set up probes/setters for device attributes 
-        for (auto a : this->dev->attributes())
-        {
-            Pothos::Callable attrGetter(&IIOSource::getDeviceAttribute);
-            Pothos::Callable attrSetter(&IIOSource::setDeviceAttribute);
-            attrGetter.bind(std::ref(*this), 0);
-            attrGetter.bind(a, 1);
-            attrSetter.bind(std::ref(*this), 0);
-            attrSetter.bind(a, 1);
-
-            std::string getDeviceAttrName = "deviceAttribute[" + a.name() + "]";
-            std::string setDeviceAttrName = "setdeviceAttribute[" + a.name() + "]";
-            this->registerCallable(getDeviceAttrName, attrGetter);
-            this->registerCallable(setDeviceAttrName, attrSetter);
-            this->registerProbe(getDeviceAttrName);
-        }
-
-        //set up probes/ports for selected input channels
+        //set up ports for selected input channels
         for (auto c : this->dev->channels())
         {
             if (c.isOutput())
@@ -121,25 +816,13 @@ public:
             if (c.isScanElement() && this->enablePorts)
             {
                 this->setupOutput(c.id(), c.dtype());
-            }
-
-            //set up probes/setters for channel attributes
-            for (auto a : c.attributes())
-            {
-                Pothos::Callable attrGetter(&IIOSource::getChannelAttribute);
-                Pothos::Callable attrSetter(&IIOSource::setChannelAttribute);
-                attrGetter.bind(std::ref(*this), 0);
-                attrGetter.bind(a, 1);
-                attrSetter.bind(std::ref(*this), 0);
-                attrSetter.bind(a, 1);
-
-                std::string getChannelAttrName = "channelAttribute[" + c.id() + "][" + a.name() + "]";
-                std::string setChannelAttrName = "setChannelAttribute[" + c.id() + "][" + a.name() + "]";
-                this->registerCallable(getChannelAttrName, attrGetter);
-                this->registerCallable(setChannelAttrName, attrSetter);
-                this->registerProbe(getChannelAttrName);
+                this->scanChannels.push_back(c);
             }
         }
+
+        //index attributes for on-demand access
+        this->attrs = IIOAttrIndex(*this->dev, this->channels);
+        this->watcher = std::unique_ptr<IIOAttrWatcher>(new IIOAttrWatcher(*this->dev, this->channels));
     }
 
     std::string overlay(void) const
@@ -192,6 +875,7 @@ public:
     void setDeviceAttribute(IIOAttr<IIODevice> a, Pothos::Object value)
     {
         a = value.toString();
+        this->labelAttributeChange(a, value.toString(), "", this->captureBoundary());
     }
 
     std::string getChannelAttribute(IIOAttr<IIOChannel> a)
@@ -202,95 +886,1639 @@ public:
     void setChannelAttribute(IIOAttr<IIOChannel> a, Pothos::Object value)
     {
         a = value.toString();
+        this->labelAttributeChange(a, value.toString(), a.owner().id(), this->captureBoundary());
     }
 
-    void activate(void)
+    std::string getAttribute(const std::string &path)
     {
-        if (!this->dev)
+        return this->attrs.read(path);
+    }
+
+    void setAttribute(const std::string &path, Pothos::Object value)
+    {
+        const auto slash = path.find('/');
+        if (IIOAttrIndex::isDebug(path))
         {
-            throw Pothos::SystemException("IIOSource::activate()", "no device specified");
+            this->attrs.write(path, value.toString());
+        }
+        else if (slash == std::string::npos)
+        {
+            this->setDeviceAttribute(this->attrs.deviceAttribute(path), value);
+        }
+        else
+        {
+            this->setChannelAttribute(this->attrs.channelAttribute(path.substr(0, slash), path.substr(slash + 1)), value);
         }
+    }
 
-        bool haveScanElements = false;
-        if (this->buf) {
-            this->buf.reset();
+    std::vector<std::string> getAttributePaths(void) const
+    {
+        return this->attrs.paths();
+    }
+
+    void setAttributeCallables(const bool enable)
+    {
+        //callables can't be unregistered, so this only ever adds them
+        if (!enable || this->attributeCallables)
+            return;
+        this->attributeCallables = true;
+        for (const auto &c : this->attrs.callables(*this))
+        {
+            this->registerCallable(c.name, c.call);
+            if (c.probe) this->registerProbe(c.name);
         }
+    }
 
-        for (auto c : this->channels)
+    uint32_t readRegister(const uint32_t address)
+    {
+        return this->attrs.readRegister(address);
+    }
+
+    void writeRegister(const uint32_t address, const uint32_t value)
+    {
+        this->attrs.writeRegister(address, value);
+    }
+
+    std::string registerTransaction(const std::string &ops)
+    {
+        return this->attrs.registerTransaction(ops);
+    }
+
+    void scheduleDeviceAttribute(unsigned long long index, const std::string &attr, Pothos::Object value)
+    {
+        this->attrs.deviceAttribute(attr);
+        this->commands.push(IIOCommand{index, "", attr, value.toString()});
+    }
+
+    void scheduleChannelAttribute(unsigned long long index, const std::string &channelId, const std::string &attr, Pothos::Object value)
+    {
+        this->attrs.channelAttribute(channelId, attr);
+        this->commands.push(IIOCommand{index, channelId, attr, value.toString()});
+    }
+
+    void clearScheduledAttributes(void)
+    {
+        this->commands.clear();
+    }
+
+    void setWatchAttributes(const std::vector<std::string> &paths)
+    {
+        if (!this->watcher)
         {
-            c.enable();
+            if (paths.empty()) return;
+            throw Pothos::SystemException("IIOSource::setWatchAttributes()", "no device specified");
+        }
+        this->watcher->setAttributes(paths);
+    }
 
-            if (c.isScanElement())
-            {
-                haveScanElements = true;
-            }
+    void setWatchInterval(const double interval)
+    {
+        if (this->watcher)
+        {
+            this->watcher->setInterval(interval);
+        }
+    }
+
+    void setWatermark(const size_t watermark)
+    {
+        if (watermark > this->bufferSize)
+        {
+            throw Pothos::RangeException("IIOSource::setWatermark()", "watermark exceeds the buffer size");
+        }
+        this->watermark = watermark;
+    }
+
+    size_t getWatermark(void)
+    {
+        return this->watermark;
+    }
+
+    size_t getDataAvailable(void)
+    {
+        if (!this->buf)
+        {
+            throw Pothos::SystemException("IIOSource::getDataAvailable()", "buffer not active");
+        }
+        return this->buf->dataAvailable();
+    }
+
+    bool hasBufferAttribute(const std::string &name)
+    {
+        for (auto a : this->dev->bufferAttributes())
+        {
+            if (a.name() == name) return true;
+        }
+        return false;
+    }
+
+    void emitWatchChanges(void)
+    {
+        std::map<std::string, std::string> changes;
+        if (!this->watcher || !this->watcher->takeChanges(changes))
+            return;
+
+        Pothos::ObjectKwargs data;
+        for (const auto &change : changes)
+        {
+            data[change.first] = Pothos::Object(change.second);
         }
+        this->emitSignal("attributesChanged", data);
+    }
+
+    void waitWatchChanges(void)
+    {
+        //an idle block waits out its work timeout for watched changes, and
+        //yields so that it keeps being called
+        if (!this->watcher || !this->watcher->isWatching()) return;
+        if (this->watcher->waitChanges(this->workInfo().maxTimeoutNs)) this->emitWatchChanges();
+        this->yield();
+    }
+
+    void issueScheduledAttributes(void)
+    {
+        if (this->commands.empty()) return;
 
-        //create sample buffer if we've got any scan elements
-        if (haveScanElements && this->enablePorts) {
-            this->buf = std::unique_ptr<IIOBuffer>(new IIOBuffer(std::move(this->dev->createBuffer(this->bufferSize, false))));
-            if (!this->buf)
+        const auto boundary = this->captureBoundary();
+        IIOCommand cmd;
+        while (this->commands.popDue(boundary, this->bufferSize, cmd))
+        {
+            Pothos::ObjectKwargs extra;
+            extra["requestedIndex"] = Pothos::Object(cmd.index);
+            extra["offset"] = Pothos::Object(static_cast<long long>(boundary - cmd.index));
+            if (cmd.channel.empty())
             {
-                throw Pothos::SystemException("IIOSource::activate()", "buffer creation failed");
+                auto a = this->attrs.deviceAttribute(cmd.attribute);
+                a = cmd.value;
+                this->labelAttributeChange(a, cmd.value, "", boundary, extra);
+            }
+            else
+            {
+                auto a = this->attrs.channelAttribute(cmd.channel, cmd.attribute);
+                a = cmd.value;
+                this->labelAttributeChange(a, cmd.value, cmd.channel, boundary, extra);
             }
-            this->buf->setBlockingMode(false);
         }
     }
 
-    void deactivate(void)
+    unsigned long long captureBoundary(void)
     {
-        if (this->buf) {
-            this->buf.reset();
+        //a write applies from the first sample the device captures after
+        //it, which comes after the samples held in the ring and those
+        //already queued in the kernel
+        unsigned long long boundary = this->totalSamples;
+        if (!this->buf) return boundary;
+        for (size_t i = 0; i < this->ringSize; ++i)
+        {
+            boundary += this->ring[(this->ringHead + i) % this->ring.size()].count;
         }
+        if (this->trackBacklog) boundary += this->buf->dataAvailable();
+        return boundary;
     }
 
-    void work(void)
+    template <class T>
+    void labelAttributeChange(IIOAttr<T> a, const std::string &written, const std::string &channelId,
+        const unsigned long long index, const Pothos::ObjectKwargs &extra = Pothos::ObjectKwargs())
     {
-        if (this->buf) {
-            //verify we have enough space in our output buffers to refill
-            if (this->workInfo().minOutElements < this->bufferSize)
-                return;
-
-            //wait for samples
-            #ifndef _MSC_VER
-            struct pollfd pfd = {
-                .fd = this->buf->fd(),
-                .events = POLLIN,
-                .revents = 0
-            };
-            struct timespec ts = {
-                .tv_sec = static_cast<time_t>(this->workInfo().maxTimeoutNs/10000000),
-                .tv_nsec = static_cast<long int>(this->workInfo().maxTimeoutNs % 10000000)
-            };
-            int ret = ppoll(&pfd, 1, &ts, NULL);
-            #else
-            struct timeval ts;// = {0, static_cast<long int>(this->workInfo().maxTimeoutNs / 1024)};
-            fd_set fds; FD_ZERO(&fds); FD_SET(this->buf->fd(), &fds);
-            int ret = select(1, &fds, NULL, NULL, &ts);
-            #endif
-            if (ret < 0)
-                throw Pothos::SystemException("IIOSource::work()", "ppoll failed: " + Poco::Error::getMessage(-ret));
-            else if (ret == 0)
-                return this->yield();
-
-            //get new samples from iio device
-            auto bytes_read = this->buf->refill();
-            //libiio read operations shouldn't return partial scans
-            assert(bytes_read % this->buf->step() == 0);
-            auto sample_count = bytes_read / this->buf->step();
-
-            //generate samples
-            for (auto c : this->channels)
-            {
-                if (c.isScanElement()) {
-                    auto outputPort = this->output(c.id());
-                    auto outputBuffer = outputPort->buffer();
-
-                    c.read(*this->buf, outputBuffer.as<void*>(), sample_count);
-                    outputPort->produce(sample_count);
+        if (this->scanChannels.empty())
+            return;
+
+        //report the value the driver actually applied where possible
+        Pothos::ObjectKwargs data(extra);
+        data["attribute"] = Pothos::Object(a.name());
+        try
+        {
+            data["value"] = Pothos::Object(a.value());
+        }
+        catch (const Pothos::Exception &)
+        {
+            data["value"] = Pothos::Object(written);
+        }
+        if (!channelId.empty())
+        {
+            data["channel"] = Pothos::Object(channelId);
+        }
+
+        //an empty port name labels every output port; scope bursts don't
+        //follow the capture, so the label marks the next delivery there
+        const auto at = this->scopeMode ? this->totalSamples : index;
+        this->pendingLabels.push_back(std::make_pair(channelId, Pothos::Label("attributeChanged", data, at)));
+    }
+
+    void postPendingLabels(const size_t n)
+    {
+        //pending labels hold a stream index; those within the next n
+        //samples are posted, and those already passed mark the first one
+        size_t kept = 0;
+        for (size_t i = 0; i < this->pendingLabels.size(); ++i)
+        {
+            const auto &pending = this->pendingLabels[i];
+            if (pending.second.index >= this->totalSamples + n)
+            {
+                if (kept != i) this->pendingLabels[kept] = pending;
+                kept++;
+                continue;
+            }
+            auto label = pending.second;
+            label.index = label.index > this->totalSamples ? label.index - this->totalSamples : 0;
+            for (auto c : this->scanChannels)
+            {
+                if (pending.first.empty() || pending.first == c.id())
+                {
+                    this->output(c.id())->postLabel(label);
                 }
             }
         }
+        this->pendingLabels.erase(this->pendingLabels.begin() + kept, this->pendingLabels.end());
+    }
+
+    void flushBuffer(void)
+    {
+        //discard samples captured while the block was inactive, bounded in
+        //time in case the device fills buffers as fast as they are read;
+        //whatever is left is just a little stale
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(maxFlushTime);
+        std::vector<IIOBuffer *> bufs(1, this->buf.get());
+        while (std::chrono::steady_clock::now() < deadline && IIOBuffer::waitAll(bufs, false, 0))
+        {
+            this->buf->refill();
+        }
+        this->backlog = 0;
+    }
+
+    void setBackpressure(const std::string &policy)
+    {
+        if (policy == "BLOCK") this->policy = Backpressure::Block;
+        else if (policy == "DROP_NEWEST") this->policy = Backpressure::DropNewest;
+        else if (policy == "DROP_OLDEST") this->policy = Backpressure::DropOldest;
+        else throw Pothos::InvalidArgumentException("IIOSource::setBackpressure()", "unknown policy: " + policy);
+        this->clearRing();
+    }
+
+    void setRingDepth(const size_t depth)
+    {
+        if (depth == 0)
+        {
+            throw Pothos::RangeException("IIOSource::setRingDepth()", "ring depth must be at least 1");
+        }
+        this->clearRing();
+        this->ring.resize(depth);
+    }
+
+    void clearRing(void)
+    {
+        for (size_t i = 0; i < this->ringSize; ++i)
+        {
+            this->dropSamples(this->ring[(this->ringHead + i) % this->ring.size()].count);
+        }
+        this->ringHead = 0;
+        this->ringSize = 0;
+    }
+
+    unsigned long long getStalls(void)
+    {
+        return this->stalls;
+    }
+
+    unsigned long long getDroppedSamples(void)
+    {
+        return this->droppedSamples;
+    }
+
+    void setWarmRestart(const bool warmRestart)
+    {
+        this->warmRestart = warmRestart;
+    }
+
+    void activate(void)
+    {
+        if (!this->dev)
+        {
+            throw Pothos::SystemException("IIOSource::activate()", "no device specified");
+        }
+        if (this->scopeMode && this->acquisitionSamples != 0)
+        {
+            throw Pothos::SystemException("IIOSource::activate()", "scope mode and finite acquisitions are exclusive");
+        }
+
+        bool haveScanElements = false;
+        this->setupTuner();
+
+        //a buffer kept by a warm restart is only reusable as configured
+        if (this->buf && !(this->warmRestart && this->activeBufferSize == this->bufferSize &&
+            this->activeWatermark == this->watermark && this->activeKernelBuffers == this->kernelBuffers)) {
+            this->closeBuffer();
+        }
+
+        for (auto c : this->channels)
+        {
+            c.enable();
+
+            if (c.isScanElement())
+            {
+                haveScanElements = true;
+            }
+        }
+
+        //create sample buffer if we've got any scan elements, unless the
+        //buffer from the last activation is reused; a finite acquisition
+        //creates a fresh one so that it starts now
+        this->canStream = haveScanElements && this->enablePorts;
+        this->captureLength = 0;
+        if (this->acquisitionSamples != 0) {
+            this->closeBuffer();
+            if (this->canStream) this->startAcquisition();
+        }
+        else if (this->buf) {
+            this->flushBuffer();
+        }
+        else if (this->canStream) {
+            this->openBuffer();
+        }
+
+        if (this->buf) {
+            this->setupStats();
+            this->setupEnvelopes();
+            this->setupHistograms();
+            this->setupCalibration();
+            this->setupCorrections();
+            this->setupDigital();
+            this->setupRing();
+        }
+
+        //a buffer kept by a warm restart follows the reactor setting
+        if (!this->reactor) {
+            this->waiter.reset();
+        }
+        else if (this->buf && !this->waiter) {
+            this->watchBuffer();
+        }
+
+        this->setupPool();
+
+        if (this->scopeMode && this->buf) {
+            this->setupScope();
+        }
+    }
+
+    void openBuffer(void)
+    {
+        //the watermark can only be changed while the buffer is disabled,
+        //and may not exceed the kernel buffer length
+        if (this->watermark != 0)
+        {
+            auto bufferAttrs = this->dev->bufferAttributes();
+            bufferAttrs.at("length") = std::to_string(this->bufferSize);
+            bufferAttrs.at("watermark") = std::to_string(this->watermark);
+        }
+        this->trackBacklog = this->hasBufferAttribute("data_available");
+        this->backlog = 0;
+        if (this->kernelBuffers != 0) this->dev->setKernelBuffersCount(static_cast<unsigned int>(this->kernelBuffers));
+
+        this->buf = std::unique_ptr<IIOBuffer>(new IIOBuffer(std::move(this->dev->createBuffer(this->bufferSize, false))));
+        if (!this->buf)
+        {
+            throw Pothos::SystemException("IIOSource::activate()", "buffer creation failed");
+        }
+        this->activeBufferSize = this->bufferSize;
+        this->activeWatermark = this->watermark;
+        this->activeKernelBuffers = this->kernelBuffers;
+        if (this->reactor) this->watchBuffer();
+
+        //refills never block the scheduler thread; after an early wakeup
+        //from the watermark they return the samples queued so far
+        this->buf->setBlockingMode(false);
+
+        //pick the fastest deinterleave kernel for this channel layout
+        this->deinterleaver = IIODeinterleaver(*this->buf, this->scanChannels);
+        this->sampleSizes.clear();
+        for (const auto &e : this->deinterleaver.layout())
+        {
+            this->sampleSizes.push_back(e.length * e.repeat);
+        }
+    }
+
+    void closeBuffer(void)
+    {
+        //the reactor must let go of the descriptor before it's closed
+        this->waiter.reset();
+        this->buf.reset();
+    }
+
+    void startAcquisition(void)
+    {
+        //streaming starts when the buffer is created
+        this->closeBuffer();
+        this->ringHead = 0;
+        this->ringSize = 0;
+        this->pendingDrops = 0;
+        this->openBuffer();
+        this->captureLength = this->acquisitionSamples;
+        this->captureRemaining = this->acquisitionSamples;
+
+        //fire the optional start trigger, given as "path=value"
+        if (!this->acquisitionStart.empty())
+        {
+            const auto eq = this->acquisitionStart.find('=');
+            if (eq == std::string::npos)
+            {
+                throw Pothos::InvalidArgumentException("IIOSource::startAcquisition()", "expected path=value: " + this->acquisitionStart);
+            }
+            this->setAttribute(this->acquisitionStart.substr(0, eq), Pothos::Object(this->acquisitionStart.substr(eq + 1)));
+        }
+    }
+
+    void endAcquisition(void)
+    {
+        //samples read past the end of the capture are not drops
+        this->closeBuffer();
+        this->ringHead = 0;
+        this->ringSize = 0;
+        this->captureLength = 0;
+    }
+
+    void setAcquisitionSamples(const unsigned long long count)
+    {
+        this->acquisitionSamples = count;
+        if (count != 0 || !this->isActive() || !this->canStream) return;
+
+        //back to streaming: a capture in progress just keeps going, and a
+        //finished one left no buffer behind
+        this->captureLength = 0;
+        if (!this->buf) this->openBuffer();
+    }
+
+    void setAcquisitionStart(const std::string &start)
+    {
+        this->acquisitionStart = start;
+    }
+
+    void arm(void)
+    {
+        if (this->acquisitionSamples == 0)
+        {
+            throw Pothos::SystemException("IIOSource::arm()", "acquisition samples not set");
+        }
+
+        //an inactive block arms on activation
+        if (this->isActive() && this->canStream)
+        {
+            this->startAcquisition();
+        }
+    }
+
+    bool isAcquiring(void)
+    {
+        return this->captureLength != 0;
+    }
+
+    void deactivate(void)
+    {
+        if (this->buf && !this->warmRestart) {
+            this->closeBuffer();
+        }
+        this->commands.clear();
+        this->pendingLabels.clear();
+        this->totalSamples = 0;
+        this->backlog = 0;
+        this->clearRing();
+        this->pendingDrops = 0;
+        this->stalled = false;
+    }
+
+    bool waitForSamples(void)
+    {
+        //a whole buffer is already queued
+        if (this->backlog >= this->bufferSize)
+            return true;
+
+        //the shared reactor has already polled the descriptor, and wakes
+        //the block again when it isn't ready yet
+        if (this->waiter)
+        {
+            if (!this->waiter->takeReady())
+                return false;
+            if (this->trackBacklog)
+                this->backlog = this->buf->dataAvailable();
+            return true;
+        }
+
+        #ifndef _MSC_VER
+        struct pollfd pfd = {
+            .fd = this->buf->fd(),
+            .events = POLLIN,
+            .revents = 0
+        };
+        struct timespec ts = {
+            .tv_sec = static_cast<time_t>(this->workInfo().maxTimeoutNs/10000000),
+            .tv_nsec = static_cast<long int>(this->workInfo().maxTimeoutNs % 10000000)
+        };
+        int ret = ppoll(&pfd, 1, &ts, NULL);
+        #else
+        struct timeval ts;// = {0, static_cast<long int>(this->workInfo().maxTimeoutNs / 1024)};
+        fd_set fds; FD_ZERO(&fds); FD_SET(this->buf->fd(), &fds);
+        int ret = select(1, &fds, NULL, NULL, &ts);
+        #endif
+        if (ret < 0)
+            throw Pothos::SystemException("IIOSource::work()", "ppoll failed: " + Poco::Error::getMessage(-ret));
+        else if (ret == 0)
+            return false;
+
+        //find out how many buffers are queued behind this wakeup
+        if (this->trackBacklog)
+            this->backlog = this->buf->dataAvailable();
+        return true;
+    }
+
+    size_t refillBuffer(void)
+    {
+        //get new samples from iio device
+        auto bytes_read = this->buf->refill();
+        //libiio read operations shouldn't return partial scans
+        assert(bytes_read % this->buf->step() == 0);
+        auto sample_count = bytes_read / this->buf->step();
+        this->backlog = this->backlog > sample_count ? this->backlog - sample_count : 0;
+        return sample_count;
+    }
+
+    void work(void)
+    {
+        //report watched attribute changes and channel statistics
+        this->emitWatchChanges();
+        this->emitStats();
+
+        //without a buffer there is nothing to stream, only changes to report
+        if (!this->buf) return this->waitWatchChanges();
+
+        //issue scheduled writes due before the next refill
+        this->issueScheduledAttributes();
+
+        //scope mode reads the device regardless of downstream, and only
+        //delivers bursts around triggers
+        if (this->scopeMode)
+            return this->workScope();
+
+        //without room downstream, the backpressure policy decides
+        //whether to keep reading from the device
+        const bool room = this->outputRoom() >= this->bufferSize;
+        if (!room && this->policy == Backpressure::Block)
+        {
+            if (!this->stalled) this->stalls++;
+            this->stalled = true;
+            return;
+        }
+        this->stalled = false;
+
+        //the freshest buffers saved while downstream was full go first
+        if (room && this->ringSize > 0)
+        {
+            auto &slot = this->ring[this->ringHead];
+            this->ringHead = (this->ringHead + 1) % this->ring.size();
+            this->ringSize--;
+            return this->deliver(slot.data.data(), slot.count);
+        }
+
+        //wait for samples and get them from the iio device
+        if (!this->waitForSamples())
+            return this->awaitSamples();
+        const auto sample_count = this->refillBuffer();
+        if (this->tuning) this->recordRefill();
+
+        if (room)
+        {
+            this->deliver(this->buf->start(), sample_count);
+            if (this->tuning) this->retuneBuffer();
+        }
+        else if (this->policy == Backpressure::DropNewest)
+        {
+            this->dropSamples(sample_count);
+            if (this->tuning) this->retuneBuffer();
+            this->yield();
+        }
+        else
+        {
+            //keep the newest buffers, dropping the oldest one when full
+            if (this->ringSize == this->ring.size())
+            {
+                this->dropSamples(this->ring[this->ringHead].count);
+                this->ringHead = (this->ringHead + 1) % this->ring.size();
+                this->ringSize--;
+            }
+            auto &slot = this->ring[(this->ringHead + this->ringSize) % this->ring.size()];
+            const auto start = static_cast<const char *>(this->buf->start());
+            slot.data.assign(start, start + sample_count * this->buf->step());
+            slot.count = sample_count;
+            this->ringSize++;
+            this->yield();
+        }
+    }
+
+    void setupScope(void)
+    {
+        //the rings hold the pre-trigger history and the staged bursts
+        const auto &sampleSizes = this->sampleSizes;
+        this->history.reset(sampleSizes, this->preTrigger);
+        this->staged.reset(sampleSizes, maxStagedBursts * (this->preTrigger + this->postTrigger));
+        this->stagedLabels.clear();
+        this->postRemaining = 0;
+        this->messageTriggered = false;
+
+        //scans are deinterleaved into scratch arrays rather than the outputs
+        this->scratch.assign(sampleSizes.size(), std::vector<char>());
+        this->scratchPtrs.clear();
+        for (size_t c = 0; c < sampleSizes.size(); ++c)
+        {
+            this->scratch[c].resize(this->bufferSize * sampleSizes[c]);
+            this->scratchPtrs.push_back(this->scratch[c].data());
+        }
+
+        this->setupTrigger();
+    }
+
+    void teardownScope(void)
+    {
+        //release the rings, and any bursts still waiting on downstream
+        this->history.reset(this->sampleSizes, 0);
+        this->staged.reset(this->sampleSizes, 0);
+        this->stagedLabels.clear();
+        this->postRemaining = 0;
+        this->scratch.clear();
+        this->scratchPtrs.clear();
+    }
+
+    void setupTrigger(void)
+    {
+        //a bad setting leaves the current trigger in place
+        size_t triggerPort = this->scanChannels.size();
+        IIOLevelTrigger levelTrigger;
+        if (!this->triggerChannel.empty())
+        {
+            for (size_t c = 0; c < this->scanChannels.size(); ++c)
+            {
+                if (this->scanChannels[c].id() == this->triggerChannel) triggerPort = c;
+            }
+            if (triggerPort == this->scanChannels.size())
+            {
+                throw Pothos::NotFoundException("IIOSource::setupTrigger()", "trigger channel not enabled: " + this->triggerChannel);
+            }
+            levelTrigger = IIOLevelTrigger(this->deinterleaver.layout()[triggerPort], this->triggerLevel,
+                this->triggerEdge, this->triggerHysteresis, this->triggerHoldoff);
+        }
+        this->triggerPort = triggerPort;
+        this->levelTrigger = levelTrigger;
+    }
+
+    bool scopeActive(void)
+    {
+        return this->scopeMode && this->buf && this->isActive();
+    }
+
+    void deinterleaveBlocks(const void *src, void *const *outputs, const size_t sample_count, const bool scope)
+    {
+        //without a trigger, taps or corrections, one pass over the whole
+        //buffer is fastest
+        if (!scope && !this->tapping() && !this->correcting() && !this->expanding())
+        {
+            if (this->pool && sample_count >= 2 * tapBlock)
+                return this->deinterleaveParallel(src, outputs, sample_count);
+            return this->deinterleaver(src, outputs, sample_count);
+        }
+
+        //deinterleave cache-sized blocks, and hand each one to the monitoring
+        //taps and the trigger while it is still hot
+        const auto in = static_cast<const char *>(src);
+        this->blockPtrs.resize(this->sampleSizes.size());
+        for (size_t begin = 0; begin < sample_count; begin += tapBlock)
+        {
+            const size_t n = std::min(tapBlock, sample_count - begin);
+            for (size_t c = 0; c < this->blockPtrs.size(); ++c)
+            {
+                this->blockPtrs[c] = static_cast<char *>(outputs[c]) + begin * this->sampleSizes[c];
+            }
+            this->deinterleaver(in + begin * this->deinterleaver.scanStep(), this->blockPtrs.data(), n);
+            this->tapSamples(this->blockPtrs.data(), n);
+            this->correctSamples(this->blockPtrs.data(), n);
+            if (!scope) this->expandDigital(this->blockPtrs.data(), begin, n);
+            if (scope) this->scopeSamples(begin, begin + n);
+        }
+    }
+
+    void setupPool(void)
+    {
+        //threads beyond the block's own come from the pool
+        if (this->deinterleaveThreads < 2) {
+            this->pool.reset();
+        }
+        else if (!this->pool || this->pool->size() != this->deinterleaveThreads - 1) {
+            this->pool = std::unique_ptr<IIOWorkerPool>(new IIOWorkerPool(this->deinterleaveThreads - 1));
+        }
+
+        //one job per thread, pointing at a range that each buffer refills
+        const size_t ranges = this->pool ? this->pool->size() + 1 : 0;
+        this->jobs.clear();
+        this->ranges.assign(ranges, IIODeinterleaveRange());
+        for (auto &range : this->ranges)
+        {
+            range.deinterleaver = &this->deinterleaver;
+            range.scans = nullptr;
+            range.outputs.resize(this->sampleSizes.size());
+            range.count = 0;
+            this->jobs.push_back(IIODeinterleaveJob{&range});
+        }
+    }
+
+    void deinterleaveParallel(const void *src, void *const *outputs, const size_t sample_count)
+    {
+        //split whole blocks evenly over the ranges; unused ones stay empty
+        const auto in = static_cast<const char *>(src);
+        const size_t blocks = (sample_count + tapBlock - 1) / tapBlock;
+        const size_t rangeSize = (blocks + this->ranges.size() - 1) / this->ranges.size() * tapBlock;
+        for (size_t r = 0; r < this->ranges.size(); ++r)
+        {
+            auto &range = this->ranges[r];
+            const size_t begin = std::min(r * rangeSize, sample_count);
+            range.count = std::min(rangeSize, sample_count - begin);
+            range.scans = in + begin * this->deinterleaver.scanStep();
+            for (size_t c = 0; c < range.outputs.size(); ++c)
+            {
+                range.outputs[c] = static_cast<char *>(outputs[c]) + begin * this->sampleSizes[c];
+            }
+        }
+        this->pool->run(this->jobs);
+    }
+
+    void setDeinterleaveThreads(const size_t threads)
+    {
+        this->deinterleaveThreads = threads;
+        if (this->buf && this->isActive()) this->setupPool();
+    }
+
+    void setReactor(const bool reactor)
+    {
+        this->reactor = reactor;
+    }
+
+    void watchBuffer(void)
+    {
+        //the reactor thread only posts to the slot, so it never waits on
+        //the block, which may be removing the waiter at the time
+        auto port = this->input("reactorReady");
+        this->waiter = IIOReactor::get().add(this->buf->fd(), [port]()
+        {
+            port->pushMessage(Pothos::Object(Pothos::ObjectVector()));
+        });
+    }
+
+    void reactorReady(void)
+    {
+        //only a wakeup; work() takes the event from the waiter
+    }
+
+    void awaitSamples(void)
+    {
+        //with the shared reactor, the block sleeps until the reactorReady
+        //slot wakes it; otherwise it polls again on the next call
+        if (!this->waiter) this->yield();
+    }
+
+    void setAdaptiveBuffer(const size_t minSize, const size_t maxSize, const size_t maxKernelBuffers)
+    {
+        if (maxSize != 0 && maxSize < std::max(minSize, this->watermark))
+        {
+            throw Pothos::RangeException("IIOSource::setAdaptiveBuffer()", "max buffer size below min buffer size or watermark");
+        }
+        this->minBufferSize = minSize;
+        this->maxBufferSize = maxSize;
+        this->maxKernelBuffers = maxKernelBuffers;
+    }
+
+    size_t getBufferSize(void)
+    {
+        return this->bufferSize;
+    }
+
+    size_t getKernelBuffers(void)
+    {
+        return this->activeKernelBuffers;
+    }
+
+    void setupTuner(void)
+    {
+        //scope bursts and captures depend on a fixed buffer
+        this->tuning = this->maxBufferSize != 0 && !this->scopeMode && this->acquisitionSamples == 0;
+        if (!this->tuning)
+        {
+            this->bufferSize = this->baseBufferSize;
+            this->kernelBuffers = 0;
+            return;
+        }
+
+        //buffers can't shrink below the watermark
+        const size_t minSize = std::max(this->minBufferSize ? this->minBufferSize : this->baseBufferSize, std::max<size_t>(this->watermark, 1));
+        this->tuner = IIOBufferTuner(minSize, std::max(this->maxBufferSize, minSize), this->bufferSize,
+            std::min(defaultKernelBuffers, this->maxKernelBuffers), this->maxKernelBuffers);
+        this->bufferSize = this->tuner.bufferSize();
+        this->kernelBuffers = this->tuner.kernelBufferCount();
+        this->tunedLosses = this->stalls + this->droppedSamples;
+    }
+
+    void setupRing(void)
+    {
+        //ring slots take buffers of any tuned size without allocating
+        if (!this->tuning || this->policy != Backpressure::DropOldest) return;
+        for (auto &slot : this->ring) slot.data.reserve(this->maxBufferSize * this->buf->step());
+    }
+
+    std::shared_ptr<Pothos::BufferManager> getOutputBufferManager(const std::string &name, const std::string &domain)
+    {
+        //a refill only goes out once there is room for a whole buffer, so
+        //ports that hold up reads must take the largest tuned size; lossy
+        //envelope ports and other domains keep the framework's choice
+        const bool envelope = name.size() > 9 && name.compare(name.size() - 9, 9, "_envelope") == 0;
+        if (this->maxBufferSize == 0 || envelope || !domain.empty())
+        {
+            return Pothos::Block::getOutputBufferManager(name, domain);
+        }
+        Pothos::BufferManagerArgs args;
+        args.bufferSize = std::max(args.bufferSize, this->maxBufferSize * this->output(name)->dtype().size());
+        return Pothos::BufferManager::make("generic", args);
+    }
+
+    void recordRefill(void)
+    {
+        //stalls and drops since the last refill, or whole buffers still
+        //queued after it, mean the device is getting ahead
+        const auto losses = this->stalls + this->droppedSamples;
+        const bool pressure = losses != this->tunedLosses || (this->trackBacklog && this->backlog >= this->bufferSize);
+        this->tunedLosses = losses;
+        this->tuner.record(pressure, this->outputRoom() > 3 * this->bufferSize);
+    }
+
+    void retuneBuffer(void)
+    {
+        //saved buffers are delivered at the size they were read
+        if (this->ringSize != 0 || !this->tuner.retune()) return;
+
+        //libiio can't resize a buffer, so samples queued in the kernel are
+        //lost with the old one
+        if (this->trackBacklog) this->dropSamples(this->buf->dataAvailable());
+        this->closeBuffer();
+        this->bufferSize = this->tuner.bufferSize();
+        this->kernelBuffers = this->tuner.kernelBufferCount();
+        this->openBuffer();
+        this->tunedLosses = this->stalls + this->droppedSamples;
+    }
+
+    void tapSamples(void *const *samples, const size_t n)
+    {
+        for (size_t i = 0; i < this->statsPorts.size(); ++i)
+        {
+            this->stats[i].accumulate(samples[this->statsPorts[i]], n);
+        }
+        for (size_t i = 0; i < this->envelopePorts.size(); ++i)
+        {
+            this->envelopes[i].accumulate(samples[this->envelopePorts[i]], n, this->envelopePoints[i]);
+        }
+        for (size_t i = 0; i < this->histogramPorts.size(); ++i)
+        {
+            this->histograms[i].accumulate(samples[this->histogramPorts[i]], n);
+        }
+    }
+
+    bool tapping(void) const
+    {
+        return !this->statsPorts.empty() || !this->envelopePorts.empty() || !this->histogramPorts.empty();
+    }
+
+    size_t outputRoom(void)
+    {
+        //envelope ports are lossy, and unused digital ports are left
+        //unconnected, so only the sample and digital ports hold up reads
+        if (!this->envelopeOutputs && this->digitalOutputs.empty()) return this->workInfo().minOutElements;
+        size_t room = std::numeric_limits<size_t>::max();
+        for (auto c : this->scanChannels)
+        {
+            room = std::min(room, this->output(c.id())->elements());
+        }
+        if (this->expanding())
+        {
+            for (const auto &name : this->digitalPorts)
+            {
+                room = std::min(room, this->output(name)->elements());
+            }
+        }
+        return room;
+    }
+
+    void setupStats(void)
+    {
+        this->stats.clear();
+        this->statsPorts.clear();
+        if (this->statsInterval <= 0.0) return;
+        const auto &layout = this->deinterleaver.layout();
+        for (size_t c = 0; c < layout.size(); ++c)
+        {
+            if (!IIOChannelStats::supports(layout[c])) continue;
+            this->stats.push_back(IIOChannelStats(layout[c]));
+            this->statsPorts.push_back(c);
+        }
+        this->nextStats = Clock::now() + this->statsPeriod();
+    }
+
+    Clock::duration statsPeriod(void) const
+    {
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(this->statsInterval));
+    }
+
+    void emitStats(void)
+    {
+        if (this->statsPorts.empty()) return;
+        const auto now = Clock::now();
+        if (now < this->nextStats) return;
+        this->nextStats = now + this->statsPeriod();
+
+        Pothos::ObjectKwargs allStats;
+        for (size_t i = 0; i < this->statsPorts.size(); ++i)
+        {
+            const auto summary = this->stats[i].summary();
+            Pothos::ObjectKwargs channelStats;
+            channelStats["count"] = Pothos::Object(summary.count);
+            channelStats["min"] = Pothos::Object(summary.min);
+            channelStats["max"] = Pothos::Object(summary.max);
+            channelStats["mean"] = Pothos::Object(summary.mean);
+            channelStats["rms"] = Pothos::Object(summary.rms);
+            channelStats["clipped"] = Pothos::Object(summary.clipped);
+            allStats[this->scanChannels[this->statsPorts[i]].id()] = Pothos::Object(channelStats);
+            this->stats[i].reset();
+        }
+        this->lastStats = allStats;
+        this->emitSignal("statsChanged", allStats);
+    }
+
+    void setStatsInterval(const double interval)
+    {
+        this->statsInterval = interval;
+        if (this->buf && this->isActive()) this->setupStats();
+    }
+
+    Pothos::ObjectKwargs getStats(void)
+    {
+        return this->lastStats;
+    }
+
+    void setupEnvelopes(void)
+    {
+        this->envelopes.clear();
+        this->envelopePorts.clear();
+        this->envelopePoints.clear();
+        if (this->envelopeDecimation == 0 || !this->envelopeOutputs) return;
+        const auto &layout = this->deinterleaver.layout();
+        for (size_t c = 0; c < layout.size(); ++c)
+        {
+            if (!IIOChannelStats::supports(layout[c])) continue;
+            this->envelopes.push_back(IIOEnvelope(layout[c], this->envelopeDecimation));
+            this->envelopePorts.push_back(c);
+        }
+        this->envelopePoints.resize(this->envelopePorts.size());
+    }
+
+    void produceEnvelopes(void)
+    {
+        for (size_t i = 0; i < this->envelopePorts.size(); ++i)
+        {
+            auto &points = this->envelopePoints[i];
+            if (points.empty()) continue;
+            auto port = this->output(this->scanChannels[this->envelopePorts[i]].id() + "_envelope");
+            const auto pointSize = this->envelopes[i].pointSize();
+            const size_t n = std::min(points.size() / pointSize, port->elements());
+            if (n > 0)
+            {
+                std::memcpy(port->buffer().as<void*>(), points.data(), n * pointSize);
+                port->produce(n);
+            }
+            points.clear();
+        }
+    }
+
+    void setEnvelopeDecimation(const size_t decimation)
+    {
+        //ports can't be added to an active block
+        if (decimation != 0 && !this->envelopeOutputs)
+        {
+            if (this->isActive())
+            {
+                throw Pothos::SystemException("IIOSource::setEnvelopeDecimation()", "envelope ports must be enabled before activation");
+            }
+            for (auto c : this->scanChannels)
+            {
+                this->setupOutput(c.id() + "_envelope", Pothos::DType::fromDType(c.dtype(), 2));
+            }
+            this->envelopeOutputs = true;
+        }
+        this->envelopeDecimation = decimation;
+        if (this->buf && this->isActive()) this->setupEnvelopes();
+    }
+
+    void setupHistograms(void)
+    {
+        this->histograms.clear();
+        this->histogramPorts.clear();
+        if (!this->codeHistogram) return;
+        const auto &layout = this->deinterleaver.layout();
+        for (size_t c = 0; c < layout.size(); ++c)
+        {
+            if (!IIOChannelStats::supports(layout[c])) continue;
+            this->histograms.push_back(IIOCodeHistogram(layout[c]));
+            this->histogramPorts.push_back(c);
+        }
+    }
+
+    void setCodeHistogram(const bool enable)
+    {
+        this->codeHistogram = enable;
+        if (this->buf && this->isActive()) this->setupHistograms();
+    }
+
+    Pothos::ObjectKwargs getHistogram(void)
+    {
+        Pothos::ObjectKwargs allHistograms;
+        for (size_t i = 0; i < this->histogramPorts.size(); ++i)
+        {
+            Pothos::ObjectKwargs histogram;
+            histogram["first"] = Pothos::Object(static_cast<long long>(this->histograms[i].first()));
+            histogram["step"] = Pothos::Object(this->histograms[i].step());
+            histogram["counts"] = Pothos::Object(this->histograms[i].counts());
+            allHistograms[this->scanChannels[this->histogramPorts[i]].id()] = Pothos::Object(histogram);
+        }
+        return allHistograms;
+    }
+
+    void resetHistogram(void)
+    {
+        for (auto &h : this->histograms) h.reset();
+    }
+
+    bool correcting(void) const
+    {
+        return !this->calibrationPorts.empty() || !this->dcPorts.empty() || !this->iqPorts.empty();
+    }
+
+    void correctSamples(void *const *samples, const size_t n)
+    {
+        for (size_t i = 0; i < this->calibrationPorts.size(); ++i)
+        {
+            this->calibrations[i].apply(samples[this->calibrationPorts[i]], n);
+        }
+        for (size_t i = 0; i < this->dcPorts.size(); ++i)
+        {
+            this->dcBlockers[i].apply(samples[this->dcPorts[i]], n);
+        }
+        for (size_t i = 0; i < this->iqPorts.size(); ++i)
+        {
+            this->iqBalancers[i].apply(samples[this->iqPorts[i].first], samples[this->iqPorts[i].second], n);
+        }
+    }
+
+    void setupCalibration(void)
+    {
+        //a bad correction leaves the current ones in place
+        std::vector<IIOCalibration> calibrations;
+        std::vector<size_t> calibrationPorts;
+        const auto &layout = this->deinterleaver.layout();
+        for (size_t c = 0; c < layout.size(); ++c)
+        {
+            const auto spec = this->calibrationSpecs.find(this->scanChannels[c].id());
+            if (spec == this->calibrationSpecs.end()) continue;
+            calibrations.push_back(IIOCalibration(layout[c], spec->second));
+            calibrationPorts.push_back(c);
+        }
+        this->calibrations.swap(calibrations);
+        this->calibrationPorts.swap(calibrationPorts);
+    }
+
+    void setCalibration(const std::string &calibration)
+    {
+        if (!this->dev) return;
+        auto specs = IIOCalibration::load(calibration, this->dev->id());
+        this->calibrationSpecs.swap(specs);
+
+        //swap corrections between buffers
+        if (!this->buf || !this->isActive()) return;
+        try
+        {
+            this->setupCalibration();
+        }
+        catch (...)
+        {
+            this->calibrationSpecs.swap(specs);
+            throw;
+        }
+    }
+
+    bool expanding(void) const
+    {
+        return this->digitalPort < this->scanChannels.size();
+    }
+
+    void setupDigital(void)
+    {
+        this->digitalPort = this->scanChannels.size();
+        this->edgeCount = 0;
+        if (this->digitalMode == DigitalMode::Off) return;
+        for (size_t c = 0; c < this->scanChannels.size(); ++c)
+        {
+            if (this->scanChannels[c].id() == this->digitalChannel) this->digitalPort = c;
+        }
+        this->expander = IIOBitExpander(this->deinterleaver.layout()[this->digitalPort], this->digitalBits);
+        this->bitPtrs.resize(this->digitalBits.size());
+    }
+
+    void expandDigital(void *const *samples, const size_t offset, const size_t n)
+    {
+        if (!this->expanding()) return;
+        const auto in = samples[this->digitalPort];
+        if (this->digitalMode == DigitalMode::Bits)
+        {
+            for (size_t k = 0; k < this->bitPtrs.size(); ++k)
+            {
+                this->bitPtrs[k] = this->output(this->digitalPorts[k])->buffer().as<uint8_t *>() + offset;
+            }
+            this->expander.expand(in, n, this->bitPtrs.data());
+        }
+        else
+        {
+            const auto out = this->output(this->digitalPorts[0])->buffer().as<uint64_t *>() + 2 * this->edgeCount;
+            this->edgeCount += this->expander.edges(in, n, this->totalSamples + offset, out);
+        }
+    }
+
+    void produceDigital(const size_t sample_count)
+    {
+        if (!this->expanding()) return;
+        if (this->digitalMode == DigitalMode::Bits)
+        {
+            for (const auto &name : this->digitalPorts)
+            {
+                this->output(name)->produce(sample_count);
+            }
+        }
+        else if (this->edgeCount > 0)
+        {
+            this->output(this->digitalPorts[0])->produce(this->edgeCount);
+            this->edgeCount = 0;
+        }
+    }
+
+    void setDigitalExpansion(const std::string &mode, const std::string &channelId, const std::vector<size_t> &bits)
+    {
+        DigitalMode digitalMode;
+        if (mode == "OFF") digitalMode = DigitalMode::Off;
+        else if (mode == "BITS") digitalMode = DigitalMode::Bits;
+        else if (mode == "EDGES") digitalMode = DigitalMode::Edges;
+        else throw Pothos::InvalidArgumentException("IIOSource::setDigitalExpansion()", "unknown digital mode: " + mode);
+
+        //find the channel and the ports the mode needs
+        std::vector<unsigned int> digitalBits;
+        std::vector<std::string> digitalPorts;
+        if (digitalMode != DigitalMode::Off)
+        {
+            auto channel = std::find_if(this->scanChannels.begin(), this->scanChannels.end(),
+                [&channelId](IIOChannel &c){ return c.id() == channelId; });
+            if (channel == this->scanChannels.end())
+            {
+                throw Pothos::NotFoundException("IIOSource::setDigitalExpansion()", "channel not enabled: " + channelId);
+            }
+            const auto format = channel->dataFormat();
+            for (const auto b : bits)
+            {
+                if (b >= format.length)
+                {
+                    throw Pothos::RangeException("IIOSource::setDigitalExpansion()", "bit out of range: " + std::to_string(b));
+                }
+                digitalBits.push_back(static_cast<unsigned int>(b));
+            }
+            if (bits.empty())
+            {
+                for (unsigned int b = 0; b < (format.bits ? format.bits : format.length); ++b) digitalBits.push_back(b);
+            }
+            if (digitalMode == DigitalMode::Bits)
+            {
+                for (const auto b : digitalBits) digitalPorts.push_back(channelId + "_bit" + std::to_string(b));
+            }
+            else digitalPorts.push_back(channelId + "_edges");
+        }
+
+        //ports can't be added to an active block
+        for (const auto &name : digitalPorts)
+        {
+            if (this->digitalOutputs.count(name) != 0) continue;
+            if (this->isActive())
+            {
+                throw Pothos::SystemException("IIOSource::setDigitalExpansion()", "digital ports must be enabled before activation");
+            }
+        }
+        for (const auto &name : digitalPorts)
+        {
+            if (this->digitalOutputs.count(name) != 0) continue;
+            if (digitalMode == DigitalMode::Bits) this->setupOutput(name, Pothos::DType(typeid(uint8_t)));
+            else this->setupOutput(name, Pothos::DType::fromDType(Pothos::DType(typeid(uint64_t)), 2));
+            this->digitalOutputs.insert(name);
+        }
+
+        this->digitalMode = digitalMode;
+        this->digitalChannel = channelId;
+        this->digitalBits = digitalBits;
+        this->digitalPorts = digitalPorts;
+        if (this->buf && this->isActive()) this->setupDigital();
+    }
+
+    void setupCorrections(void)
+    {
+        //a bad channel list leaves the current corrections in place
+        const auto &layout = this->deinterleaver.layout();
+        const auto scanPort = [this](const std::string &channelId) -> size_t
+        {
+            for (size_t c = 0; c < this->scanChannels.size(); ++c)
+            {
+                if (this->scanChannels[c].id() == channelId) return c;
+            }
+            throw Pothos::NotFoundException("IIOSource::setupCorrections()", "correction channel not enabled: " + channelId);
+        };
+
+        std::vector<IIODCBlocker> dcBlockers;
+        std::vector<size_t> dcPorts;
+        for (const auto &id : this->dcChannels)
+        {
+            const auto c = scanPort(id);
+            if (!IIOChannelStats::supports(layout[c]))
+            {
+                throw Pothos::InvalidArgumentException("IIOSource::setupCorrections()", "unsupported DC channel format: " + id);
+            }
+            dcBlockers.push_back(IIODCBlocker(layout[c], this->correctionTime));
+            dcPorts.push_back(c);
+        }
+
+        std::vector<IIOIQBalancer> iqBalancers;
+        std::vector<std::pair<size_t, size_t>> iqPorts;
+        for (size_t k = 0; k + 1 < this->iqChannels.size(); k += 2)
+        {
+            const auto i = scanPort(this->iqChannels[k]);
+            const auto q = scanPort(this->iqChannels[k + 1]);
+            iqBalancers.push_back(IIOIQBalancer(layout[i], layout[q], this->correctionTime));
+            iqPorts.push_back(std::make_pair(i, q));
+        }
+
+        this->dcBlockers.swap(dcBlockers);
+        this->dcPorts.swap(dcPorts);
+        this->iqBalancers.swap(iqBalancers);
+        this->iqPorts.swap(iqPorts);
+    }
+
+    template <typename T>
+    void updateCorrections(T &setting, T value)
+    {
+        //swap corrections between buffers
+        std::swap(setting, value);
+        if (!this->buf || !this->isActive()) return;
+        try
+        {
+            this->setupCorrections();
+        }
+        catch (...)
+        {
+            std::swap(setting, value);
+            throw;
+        }
+    }
+
+    void setDCChannels(const std::vector<std::string> &channelIds)
+    {
+        this->updateCorrections(this->dcChannels, channelIds);
+    }
+
+    void setIQChannels(const std::vector<std::string> &channelIds)
+    {
+        if (channelIds.size() % 2 != 0)
+        {
+            throw Pothos::InvalidArgumentException("IIOSource::setIQChannels()", "expected pairs of I and Q channel IDs");
+        }
+        this->updateCorrections(this->iqChannels, channelIds);
+    }
+
+    void setCorrectionTime(const double samples)
+    {
+        if (samples <= 0.0)
+        {
+            throw Pothos::RangeException("IIOSource::setCorrectionTime()", "correction time must be positive");
+        }
+        this->updateCorrections(this->correctionTime, samples);
+    }
+
+    Pothos::ObjectKwargs getDCOffsets(void)
+    {
+        Pothos::ObjectKwargs offsets;
+        for (size_t i = 0; i < this->dcPorts.size(); ++i)
+        {
+            offsets[this->scanChannels[this->dcPorts[i]].id()] = Pothos::Object(this->dcBlockers[i].offset());
+        }
+        return offsets;
+    }
+
+    Pothos::ObjectKwargs getIQImbalance(void)
+    {
+        Pothos::ObjectKwargs imbalances;
+        for (size_t i = 0; i < this->iqPorts.size(); ++i)
+        {
+            const auto &ports = this->iqPorts[i];
+            Pothos::ObjectKwargs imbalance;
+            imbalance["amplitude"] = Pothos::Object(this->iqBalancers[i].amplitudeRatio());
+            imbalance["phase"] = Pothos::Object(this->iqBalancers[i].phaseError());
+            imbalances[this->scanChannels[ports.first].id() + "/" + this->scanChannels[ports.second].id()] = Pothos::Object(imbalance);
+        }
+        return imbalances;
+    }
+
+    void workScope(void)
+    {
+        //keep reading the device, then deliver as much of the staged
+        //bursts as fits downstream
+        if (this->waitForSamples())
+        {
+            const auto sample_count = this->refillBuffer();
+            this->deinterleaveBlocks(this->buf->start(), this->scratchPtrs.data(), sample_count, true);
+            this->produceEnvelopes();
+        }
+        else this->awaitSamples();
+        this->drainStaged();
+    }
+
+    void scopeSamples(const size_t begin, const size_t end)
+    {
+        //i is the next sample to route, and j the next one to scan
+        size_t i = begin, j = begin;
+        while (true)
+        {
+            size_t k = end;
+            std::string source;
+            if (this->messageTriggered && j < end)
+            {
+                k = j;
+                source = "message";
+                this->messageTriggered = false;
+            }
+            else if (this->triggerPort < this->scanChannels.size() && j < end)
+            {
+                const auto samples = this->scratch[this->triggerPort].data() + j * this->sampleSizes[this->triggerPort];
+                k = j + this->levelTrigger.find(samples, end - j);
+                source = this->triggerChannel;
+                j = k + 1;
+            }
+            this->routeSamples(i, k);
+            i = k;
+            if (k == end) break;
+            this->fireTrigger(source);
+        }
+    }
+
+    void routeSamples(size_t i, const size_t k)
+    {
+        //samples inside an open window are captured, the rest become history
+        //a burst kept open by retriggers is cut short when the staged ring
+        //fills up
+        if (this->postRemaining > 0)
+        {
+            const size_t n = size_t(std::min<unsigned long long>(k - i, this->postRemaining));
+            const size_t m = std::min(n, this->staged.room());
+            this->staged.append(this->scratchPtrs.data(), i, m);
+            this->postRemaining = m < n ? 0 : this->postRemaining - n;
+            i += m;
+            if (this->postRemaining == 0)
+            {
+                const auto length = this->staged.position() + this->staged.size() - this->burstStart;
+                this->stageLabel(Pothos::Label("rxEnd", Pothos::Object(length), 0), -1);
+            }
+        }
+
+        //keep the most recent samples as pre-trigger history, making room
+        //in the ring first
+        const size_t n = std::min(k - i, this->preTrigger);
+        this->history.discard(std::min(this->history.size(), n > this->history.room() ? n - this->history.room() : 0));
+        this->history.append(this->scratchPtrs.data(), k - n, n);
+    }
+
+    void fireTrigger(const std::string &source)
+    {
+        //a trigger inside an open window keeps the window open
+        if (this->postRemaining > 0)
+        {
+            this->stageLabel(Pothos::Label("trigger", Pothos::Object(source), 0), 0);
+            this->postRemaining = this->postTrigger;
+            return;
+        }
+
+        //bound the bursts waiting on downstream
+        const size_t pre = std::min(this->preTrigger, this->history.size());
+        if (this->staged.size() + pre + this->postTrigger > maxStagedBursts * (this->preTrigger + this->postTrigger))
+        {
+            this->missedTriggers++;
+            return;
+        }
+
+        //stage the history leading up to the trigger, then capture from
+        //the trigger onwards
+        this->burstStart = this->staged.position() + this->staged.size();
+        this->staged.append(this->history, this->history.size() - pre, pre);
+        this->history.clear();
+        this->stageLabel(Pothos::Label("trigger", Pothos::Object(source), 0), 0);
+        this->postRemaining = this->postTrigger;
+        this->bursts++;
+    }
+
+    void stageLabel(const Pothos::Label &label, const long long offset)
+    {
+        //label the sample at offset from the end of the staged samples
+        const auto index = this->staged.position() + this->staged.size() + offset;
+        this->stagedLabels.push_back(std::make_pair(index, label));
+    }
+
+    void drainStaged(void)
+    {
+        const size_t n = std::min(this->staged.size(), this->outputRoom());
+        if (n == 0) return;
+
+        this->outputs.clear();
+        for (auto c : this->scanChannels)
+        {
+            this->outputs.push_back(this->output(c.id())->buffer().as<void*>());
+        }
+        const auto begin = this->staged.position();
+        this->staged.pop(this->outputs.data(), n);
+        this->expandDigital(this->outputs.data(), 0, n);
+        this->produceDigital(n);
+        this->postPendingLabels(n);
+        while (!this->stagedLabels.empty() && this->stagedLabels.front().first < begin + n)
+        {
+            auto label = this->stagedLabels.front().second;
+            label.index = this->stagedLabels.front().first - begin;
+            for (auto c : this->scanChannels)
+            {
+                this->output(c.id())->postLabel(label);
+            }
+            this->stagedLabels.pop_front();
+        }
+        for (auto c : this->scanChannels)
+        {
+            this->output(c.id())->produce(n);
+        }
+        this->totalSamples += n;
+    }
+
+    void setScopeMode(const bool enable)
+    {
+        if (enable == this->scopeMode) return;
+        if (enable && this->acquisitionSamples != 0 && this->isActive())
+        {
+            throw Pothos::SystemException("IIOSource::setScopeMode()", "scope mode and finite acquisitions are exclusive");
+        }
+
+        //switch over between buffers, setting up first so that a bad
+        //trigger channel leaves streaming as it was
+        if (this->buf && this->isActive())
+        {
+            if (enable) this->setupScope();
+            else this->teardownScope();
+        }
+        this->scopeMode = enable;
+    }
+
+    void setPreTrigger(const size_t samples)
+    {
+        this->preTrigger = samples;
+        if (this->scopeActive()) this->setupScope();
+    }
+
+    void setPostTrigger(const size_t samples)
+    {
+        //the triggering sample is the first post-trigger sample
+        if (samples == 0)
+        {
+            throw Pothos::RangeException("IIOSource::setPostTrigger()", "post trigger must be at least 1");
+        }
+        this->postTrigger = samples;
+        if (this->scopeActive()) this->setupScope();
+    }
+
+    void setTriggerChannel(const std::string &channelId)
+    {
+        const auto old = this->triggerChannel;
+        this->triggerChannel = channelId;
+        if (!this->scopeActive()) return;
+        try
+        {
+            this->setupTrigger();
+        }
+        catch (...)
+        {
+            this->triggerChannel = old;
+            throw;
+        }
+    }
+
+    void setTriggerLevel(const double level)
+    {
+        this->triggerLevel = level;
+        if (this->scopeActive()) this->setupTrigger();
+    }
+
+    void setTriggerEdge(const std::string &edge)
+    {
+        if (edge == "RISING") this->triggerEdge = IIOLevelTrigger::Rising;
+        else if (edge == "FALLING") this->triggerEdge = IIOLevelTrigger::Falling;
+        else if (edge == "BOTH") this->triggerEdge = IIOLevelTrigger::Both;
+        else throw Pothos::InvalidArgumentException("IIOSource::setTriggerEdge()", "unknown edge: " + edge);
+        if (this->scopeActive()) this->setupTrigger();
+    }
+
+    void setTriggerHysteresis(const double hysteresis)
+    {
+        if (hysteresis < 0.0)
+        {
+            throw Pothos::RangeException("IIOSource::setTriggerHysteresis()", "negative hysteresis");
+        }
+        this->triggerHysteresis = hysteresis;
+        if (this->scopeActive()) this->setupTrigger();
+    }
+
+    void setTriggerHoldoff(const unsigned long long samples)
+    {
+        this->triggerHoldoff = samples;
+        if (this->scopeActive()) this->setupTrigger();
+    }
+
+    unsigned long long getMissedTriggers(void)
+    {
+        return this->missedTriggers;
+    }
+
+    void trigger(void)
+    {
+        this->messageTriggered = true;
+    }
+
+    unsigned long long getBursts(void)
+    {
+        return this->bursts;
+    }
+
+    void deliver(const void *src, size_t sample_count)
+    {
+        //a finite acquisition ends partway through its final buffer
+        if (this->captureLength != 0)
+        {
+            sample_count = size_t(std::min<unsigned long long>(sample_count, this->captureRemaining));
+        }
+
+        //generate samples
+        this->outputs.clear();
+        for (auto c : this->scanChannels)
+        {
+            this->outputs.push_back(this->output(c.id())->buffer().as<void*>());
+        }
+        this->deinterleaveBlocks(src, this->outputs.data(), sample_count, false);
+        this->produceEnvelopes();
+        this->produceDigital(sample_count);
+        if (sample_count > 0)
+        {
+            //label the gap left by samples dropped since the last delivery
+            if (this->pendingDrops > 0)
+            {
+                this->pendingLabels.push_back(std::make_pair(std::string(),
+                    Pothos::Label("dropped", Pothos::Object(this->pendingDrops), this->totalSamples)));
+                this->pendingDrops = 0;
+            }
+            this->postPendingLabels(sample_count);
+        }
+        const bool lastSamples = this->captureLength != 0 && sample_count == this->captureRemaining;
+        for (auto c : this->scanChannels)
+        {
+            if (lastSamples && sample_count > 0)
+            {
+                this->output(c.id())->postLabel(Pothos::Label("rxEnd", Pothos::Object(this->captureLength), sample_count - 1));
+            }
+            this->output(c.id())->produce(sample_count);
+        }
+        this->totalSamples += sample_count;
+
+        if (this->captureLength != 0)
+        {
+            this->captureRemaining -= sample_count;
+            if (this->captureRemaining == 0) this->endAcquisition();
+        }
+    }
+
+    void dropSamples(const size_t sample_count)
+    {
+        this->droppedSamples += sample_count;
+        this->pendingDrops += sample_count;
     }
 };
 
@@ -4,7 +4,14 @@
 #include "IIOSupport.hpp"
 #include <Pothos/Framework.hpp>
 #include <Poco/Error.h>
+#ifndef _MSC_VER
+#include <poll.h>
+#else
+#include <winsock2.h>
+#endif
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstring>
 
 IIOContextRaw::IIOContextRaw(void)
@@ -65,6 +72,18 @@ std::vector<IIODevice> IIOContext::devices(void)
     return d;
 }
 
+IIODevice IIOContext::device(const std::string &id)
+{
+    for (auto d : this->devices())
+    {
+        if (d.id() == id)
+        {
+            return d;
+        }
+    }
+    throw Pothos::NotFoundException("IIOContext::device()", "device not found: " + id);
+}
+
 template <class T>
 IIOAttrs<T>::IIOAttrs(T parent) : parent(parent) {}
 
@@ -133,6 +152,12 @@ std::string IIOAttr<T>::value()
     return std::string(*this);
 }
 
+template <class T>
+T IIOAttr<T>::owner()
+{
+    return this->parent;
+}
+
 template <class T>
 IIOAttr<T>& IIOAttr<T>::operator=(const std::string& other)
 {
@@ -162,8 +187,12 @@ IIOAttr<T>::operator std::string() const
 
 template class IIOAttr<IIOChannel>;
 template class IIOAttr<IIODevice>;
+template class IIOAttr<IIODeviceBuffer>;
+template class IIOAttr<IIODeviceDebug>;
 template class IIOAttrs<IIOChannel>;
 template class IIOAttrs<IIODevice>;
+template class IIOAttrs<IIODeviceBuffer>;
+template class IIOAttrs<IIODeviceDebug>;
 
 IIODevice::IIODevice(std::shared_ptr<IIOContextRaw> ctx, const struct iio_device *device)
     : ctx(ctx), device(device) {}
@@ -207,6 +236,73 @@ IIOAttrs<IIODevice> IIODevice::attributes(void)
     return IIOAttrs<IIODevice>(*this);
 }
 
+static int readDeviceAttribute(struct iio_device *, const char *attr, const char *value, size_t len, void *d)
+{
+    auto values = static_cast<std::map<std::string, std::string> *>(d);
+    (*values)[attr] = std::string(value, strnlen(value, len));
+    return 0;
+}
+
+std::map<std::string, std::string> IIODevice::readAttributes(void)
+{
+    std::map<std::string, std::string> values;
+    int ret = iio_device_attr_read_all(const_cast<struct iio_device *>(this->device), &readDeviceAttribute, &values);
+    if (ret < 0)
+    {
+        throw Pothos::SystemException("IIODevice::readAttributes()", "iio_device_attr_read_all: " + Poco::Error::getMessage(-ret));
+    }
+    return values;
+}
+
+IIOAttrs<IIODeviceDebug> IIODevice::debugAttributes(void)
+{
+    return IIODeviceDebug(*this).attributes();
+}
+
+IIOAttrs<IIODeviceBuffer> IIODevice::bufferAttributes(void)
+{
+    return IIODeviceBuffer(*this).attributes();
+}
+
+uint32_t IIODevice::readRegister(uint32_t address)
+{
+    uint32_t value = 0;
+    int ret = iio_device_reg_read(const_cast<struct iio_device *>(this->device), address, &value);
+    if (ret < 0)
+    {
+        throw Pothos::SystemException("IIODevice::readRegister()", "iio_device_reg_read: " + Poco::Error::getMessage(-ret));
+    }
+    return value;
+}
+
+void IIODevice::writeRegister(uint32_t address, uint32_t value)
+{
+    int ret = iio_device_reg_write(const_cast<struct iio_device *>(this->device), address, value);
+    if (ret < 0)
+    {
+        throw Pothos::SystemException("IIODevice::writeRegister()", "iio_device_reg_write: " + Poco::Error::getMessage(-ret));
+    }
+}
+
+std::vector<uint32_t> IIODevice::registerTransaction(const std::vector<RegisterOp> &ops)
+{
+    std::vector<uint32_t> results;
+    results.reserve(ops.size());
+    for (const auto &op : ops)
+    {
+        if (op.write)
+        {
+            this->writeRegister(op.address, op.value);
+            results.push_back(op.value);
+        }
+        else
+        {
+            results.push_back(this->readRegister(op.address));
+        }
+    }
+    return results;
+}
+
 std::vector<IIOChannel> IIODevice::channels(void)
 {
     auto channel_count = iio_device_get_channels_count(this->device);
@@ -237,7 +333,7 @@ IIODevice IIODevice::trigger(void)
 
 void IIODevice::setTrigger(IIODevice *trigger)
 {
-    int ret = iio_device_set_trigger(this->device, trigger->device);
+    int ret = iio_device_set_trigger(this->device, trigger ? trigger->device : nullptr);
     if (ret)
     {
         throw Pothos::SystemException("IIODevice::setTrigger()", "iio_device_set_trigger: " + Poco::Error::getMessage(-ret));
@@ -263,6 +359,70 @@ IIOBuffer IIODevice::createBuffer(size_t samples_count, bool cyclic)
     return IIOBuffer(this->ctx, this, samples_count, cyclic);
 }
 
+IIODeviceDebug::IIODeviceDebug(IIODevice dev) : dev(dev) {}
+
+const char * IIODeviceDebug::iio_get_attr(unsigned int idx) const
+{
+    return iio_device_get_debug_attr(this->dev.device, idx);
+}
+
+unsigned int IIODeviceDebug::iio_get_attrs_count() const
+{
+    return iio_device_get_debug_attrs_count(this->dev.device);
+}
+
+ssize_t IIODeviceDebug::iio_attr_read(const char *attr, char *dst, size_t len) const
+{
+    return iio_device_debug_attr_read(this->dev.device, attr, dst, len);
+}
+
+ssize_t IIODeviceDebug::iio_attr_write(const char *attr, const char *src) const
+{
+    return iio_device_debug_attr_write(this->dev.device, attr, src);
+}
+
+IIODevice IIODeviceDebug::device(void)
+{
+    return this->dev;
+}
+
+IIOAttrs<IIODeviceDebug> IIODeviceDebug::attributes(void)
+{
+    return IIOAttrs<IIODeviceDebug>(*this);
+}
+
+IIODeviceBuffer::IIODeviceBuffer(IIODevice dev) : dev(dev) {}
+
+const char * IIODeviceBuffer::iio_get_attr(unsigned int idx) const
+{
+    return iio_device_get_buffer_attr(this->dev.device, idx);
+}
+
+unsigned int IIODeviceBuffer::iio_get_attrs_count() const
+{
+    return iio_device_get_buffer_attrs_count(this->dev.device);
+}
+
+ssize_t IIODeviceBuffer::iio_attr_read(const char *attr, char *dst, size_t len) const
+{
+    return iio_device_buffer_attr_read(this->dev.device, attr, dst, len);
+}
+
+ssize_t IIODeviceBuffer::iio_attr_write(const char *attr, const char *src) const
+{
+    return iio_device_buffer_attr_write(this->dev.device, attr, src);
+}
+
+IIODevice IIODeviceBuffer::device(void)
+{
+    return this->dev;
+}
+
+IIOAttrs<IIODeviceBuffer> IIODeviceBuffer::attributes(void)
+{
+    return IIOAttrs<IIODeviceBuffer>(*this);
+}
+
 IIOChannel::IIOChannel(std::shared_ptr<IIOContextRaw> ctx, struct iio_channel *channel) : ctx(ctx), channel(channel) {}
 
 const char * IIOChannel::iio_get_attr(unsigned int idx) const
@@ -309,6 +469,24 @@ IIOAttrs<IIOChannel> IIOChannel::attributes(void)
     return IIOAttrs<IIOChannel>(*this);
 }
 
+static int readChannelAttribute(struct iio_channel *, const char *attr, const char *value, size_t len, void *d)
+{
+    auto values = static_cast<std::map<std::string, std::string> *>(d);
+    (*values)[attr] = std::string(value, strnlen(value, len));
+    return 0;
+}
+
+std::map<std::string, std::string> IIOChannel::readAttributes(void)
+{
+    std::map<std::string, std::string> values;
+    int ret = iio_channel_attr_read_all(this->channel, &readChannelAttribute, &values);
+    if (ret < 0)
+    {
+        throw Pothos::SystemException("IIOChannel::readAttributes()", "iio_channel_attr_read_all: " + Poco::Error::getMessage(-ret));
+    }
+    return values;
+}
+
 void IIOChannel::enable(void)
 {
     iio_channel_enable(this->channel);
@@ -337,7 +515,7 @@ bool IIOChannel::isScanElement(void)
 size_t IIOChannel::read(IIOBuffer &buffer, void *dst, size_t sample_count)
 {
     const struct iio_data_format *format = iio_channel_get_data_format(this->channel);
-    size_t len = sample_count * format->length;
+    size_t len = sample_count * (format->length / 8);
     return iio_channel_read(this->channel, buffer.buffer, dst, len);
 }
 
@@ -348,6 +526,16 @@ size_t IIOChannel::write(IIOBuffer &buffer, void *dst, size_t sample_count)
     return iio_channel_write(this->channel, buffer.buffer, dst, len);
 }
 
+void IIOChannel::convert(void *dst, const void *src)
+{
+    iio_channel_convert(this->channel, dst, src);
+}
+
+void IIOChannel::convertInverse(void *dst, const void *src)
+{
+    iio_channel_convert_inverse(this->channel, dst, src);
+}
+
 Pothos::DType IIOChannel::dtype(void)
 {
     const struct iio_data_format *format = iio_channel_get_data_format(this->channel);
@@ -382,8 +570,13 @@ Pothos::DType IIOChannel::dtype(void)
     }
 }
 
+struct iio_data_format IIOChannel::dataFormat(void)
+{
+    return *iio_channel_get_data_format(this->channel);
+}
+
 IIOBuffer::IIOBuffer(std::shared_ptr<IIOContextRaw> ctx, IIODevice *device, size_t samples_count, bool cyclic)
-    : ctx(ctx)
+    : ctx(ctx), dataAvailableInBytes(false)
 {
     this->buffer = iio_device_create_buffer(device->device, samples_count, cyclic);
     if (!this->buffer)
@@ -393,7 +586,8 @@ IIOBuffer::IIOBuffer(std::shared_ptr<IIOContextRaw> ctx, IIODevice *device, size
 }
 
 IIOBuffer::IIOBuffer(IIOBuffer&& other)
-    : ctx(std::move(other.ctx))
+    : ctx(std::move(other.ctx)), dataAvailableAttr(std::move(other.dataAvailableAttr)),
+    dataAvailableInBytes(other.dataAvailableInBytes)
 {
     this->buffer = other.buffer;
     other.buffer = nullptr;
@@ -430,6 +624,112 @@ int IIOBuffer::fd(void)
     return ret;
 }
 
+bool IIOBuffer::waitAll(const std::vector<IIOBuffer *> &buffers, bool output, long long timeoutNs)
+{
+    std::vector<bool> ready(buffers.size(), false);
+    size_t numReady = 0;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::nanoseconds(timeoutNs);
+
+    //keep waiting on the buffers that aren't ready yet; a buffer that has
+    //become ready stays ready until it is refilled or pushed
+    while (numReady < buffers.size())
+    {
+        //every pass waits out the rest of the one timeout, and still polls
+        //once it has expired
+        timeoutNs = std::max<long long>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(
+            deadline - std::chrono::steady_clock::now()).count());
+
+        #ifndef _MSC_VER
+        std::vector<struct pollfd> pfds;
+        std::vector<size_t> idxs;
+        for (size_t i = 0; i < buffers.size(); ++i)
+        {
+            if (ready[i]) continue;
+            struct pollfd pfd = {
+                .fd = buffers[i]->fd(),
+                .events = static_cast<short>(output ? POLLOUT : POLLIN),
+                .revents = 0
+            };
+            pfds.push_back(pfd);
+            idxs.push_back(i);
+        }
+        struct timespec ts = {
+            .tv_sec = static_cast<time_t>(timeoutNs / 1000000000),
+            .tv_nsec = static_cast<long int>(timeoutNs % 1000000000)
+        };
+        int ret = ppoll(pfds.data(), pfds.size(), &ts, NULL);
+        if (ret < 0)
+            throw Pothos::SystemException("IIOBuffer::waitAll()", "ppoll failed: " + Poco::Error::getMessage(Poco::Error::last()));
+        else if (ret == 0)
+            return false;
+        for (size_t j = 0; j < pfds.size(); ++j)
+        {
+            //an error condition would be reported again on every poll
+            if ((pfds[j].revents & (POLLERR | POLLHUP | POLLNVAL)) &&
+                !(pfds[j].revents & (output ? POLLOUT : POLLIN)))
+            {
+                throw Pothos::SystemException("IIOBuffer::waitAll()", "buffer " +
+                    buffers[idxs[j]]->device().id() + " reported a poll error");
+            }
+            if (pfds[j].revents & (output ? POLLOUT : POLLIN))
+            {
+                ready[idxs[j]] = true;
+                numReady++;
+            }
+        }
+        #else
+        struct timeval ts = {
+            static_cast<long>(timeoutNs / 1000000000),
+            static_cast<long>((timeoutNs % 1000000000) / 1000)
+        };
+        fd_set fds; FD_ZERO(&fds);
+        int maxFd = 0;
+        for (size_t i = 0; i < buffers.size(); ++i)
+        {
+            if (ready[i]) continue;
+            FD_SET(buffers[i]->fd(), &fds);
+            maxFd = std::max(maxFd, buffers[i]->fd());
+        }
+        int ret = output ? select(maxFd + 1, NULL, &fds, NULL, &ts) : select(maxFd + 1, &fds, NULL, NULL, &ts);
+        if (ret < 0)
+            throw Pothos::SystemException("IIOBuffer::waitAll()", "select failed: " + Poco::Error::getMessage(Poco::Error::last()));
+        else if (ret == 0)
+            return false;
+        for (size_t i = 0; i < buffers.size(); ++i)
+        {
+            if (!ready[i] && FD_ISSET(buffers[i]->fd(), &fds))
+            {
+                ready[i] = true;
+                numReady++;
+            }
+        }
+        #endif
+    }
+    return true;
+}
+
+size_t IIOBuffer::dataAvailable(void)
+{
+    if (!this->dataAvailableAttr)
+    {
+        //iio_dma_buffer reports bytes, and only dmaengine buffers have
+        //length_align_bytes; kfifo buffers report whole scans
+        for (auto a : this->device().bufferAttributes())
+        {
+            const auto name = a.name();
+            if (name == "data_available") this->dataAvailableAttr.reset(new IIOAttr<IIODeviceBuffer>(a));
+            else if (name == "length_align_bytes") this->dataAvailableInBytes = true;
+        }
+        if (!this->dataAvailableAttr)
+        {
+            throw Pothos::RangeException("IIOBuffer::dataAvailable()", "attribute not found: data_available");
+        }
+    }
+
+    const auto available = std::stoull(this->dataAvailableAttr->value());
+    return this->dataAvailableInBytes ? available / this->step() : available;
+}
+
 size_t IIOBuffer::refill(void)
 {
     ssize_t ret = iio_buffer_refill(this->buffer);
@@ -464,3 +764,8 @@ ptrdiff_t IIOBuffer::step(void)
 {
     return iio_buffer_step(this->buffer);
 }
+
+void * IIOBuffer::first(IIOChannel &channel)
+{
+    return iio_buffer_first(this->buffer, channel.channel);
+}
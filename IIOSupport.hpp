@@ -1,10 +1,13 @@
 // Copyright (c) 2016 Fiach Antaw
 // SPDX-License-Identifier: BSL-1.0
 
+#pragma once
 #include <Pothos/Framework.hpp>
 #include <iio.h>
 #include <memory>
 #include <Poco/SingletonHolder.h>
+#include <cstdint>
+#include <map>
 #include <string>
 #include <vector>
 #include <iterator>
@@ -14,6 +17,8 @@ class IIOAttr;
 class IIOBuffer;
 class IIOChannel;
 class IIODevice;
+class IIODeviceBuffer;
+class IIODeviceDebug;
 
 /*!
  * IIOContextRaw contains a raw iio_context pointer, which it destroys
@@ -68,6 +73,13 @@ public:
      * devices available through this libiio context.
      */
     std::vector<IIODevice> devices(void);
+
+    /*!
+     * Get the IIODevice object with the given ID.
+     *
+     * If no such device exists, a Pothos::NotFoundException will be thrown.
+     */
+    IIODevice device(const std::string &id);
 };
 
 /*!
@@ -146,6 +158,11 @@ public:
      */
     std::string value();
 
+    /*!
+     * Get the object that this attribute belongs to.
+     */
+    T owner();
+
     IIOAttr<T>& operator= (const std::string& other);
     operator std::string() const;
 };
@@ -160,6 +177,8 @@ class IIODevice
     friend class IIOBuffer;
     friend class IIOChannel;
     friend class IIOContext;
+    friend class IIODeviceBuffer;
+    friend class IIODeviceDebug;
 private:
     std::shared_ptr<IIOContextRaw> ctx;
     const struct iio_device *device;
@@ -198,6 +217,56 @@ public:
      */
     IIOAttrs<IIODevice> attributes(void);
 
+    /*!
+     * Read the values of all attributes of this IIO device at once.
+     *
+     * On remote contexts this takes a single round trip.
+     */
+    std::map<std::string, std::string> readAttributes(void);
+
+    /*!
+     * The debugAttributes() method returns an object exposing debug
+     * attributes available to be read or set on this IIO device.
+     */
+    IIOAttrs<IIODeviceDebug> debugAttributes(void);
+
+    /*!
+     * The bufferAttributes() method returns an object exposing buffer
+     * attributes, such as "length", "watermark" and "data_available",
+     * available to be read or set on this IIO device.
+     */
+    IIOAttrs<IIODeviceBuffer> bufferAttributes(void);
+
+    /*!
+     * Read a 32-bit register of this IIO device.
+     */
+    uint32_t readRegister(uint32_t address);
+
+    /*!
+     * Write a 32-bit register of this IIO device.
+     */
+    void writeRegister(uint32_t address, uint32_t value);
+
+    /*!
+     * A single register access within a register transaction.
+     */
+    struct RegisterOp
+    {
+        uint32_t address;
+        uint32_t value;
+        bool write;
+    };
+
+    /*!
+     * Apply a list of register reads and writes in order.
+     * Each operation is a separate iio_device_reg_read/reg_write call.
+     *
+     * The result holds one value per operation: the value read for reads,
+     * and the value written for writes. If an operation fails, the
+     * operations before it have already been applied.
+     */
+    std::vector<uint32_t> registerTransaction(const std::vector<RegisterOp> &ops);
+
     /*!
      * The channels() method returns a set of IIOChannel objects representing
      * channels available on this IIO device.
@@ -235,6 +304,90 @@ public:
     IIOBuffer createBuffer(size_t samples_count, bool cyclic);
 };
 
+/*!
+ * IIODeviceDebug exposes the debug attributes of an IIODevice through the
+ * same IIOAttrs/IIOAttr interface as its regular attributes.
+ */
+class IIODeviceDebug
+{
+    friend class IIOAttr<IIODeviceDebug>;
+    friend class IIOAttrs<IIODeviceDebug>;
+    friend class IIODevice;
+private:
+    IIODevice dev;
+
+    IIODeviceDebug(IIODevice dev);
+
+    const char * iio_get_attr(unsigned int idx) const;
+    unsigned int iio_get_attrs_count() const;
+    ssize_t iio_attr_read(const char *attr, char *dst, size_t len) const;
+    ssize_t iio_attr_write(const char *attr, const char *src) const;
+public:
+
+    bool operator==(IIODeviceDebug other) const
+    {
+        return this->dev == other.dev;
+    }
+
+    bool operator!=(IIODeviceDebug other) const
+    {
+        return !(*this == other);
+    }
+
+    /*!
+     * Get the device that these debug attributes belong to.
+     */
+    IIODevice device(void);
+
+    /*!
+     * The attributes() method returns an object exposing the debug
+     * attributes of the device.
+     */
+    IIOAttrs<IIODeviceDebug> attributes(void);
+};
+
+/*!
+ * IIODeviceBuffer exposes the buffer attributes of an IIODevice through the
+ * IIOAttrs interface.
+ */
+class IIODeviceBuffer
+{
+    friend class IIOAttr<IIODeviceBuffer>;
+    friend class IIOAttrs<IIODeviceBuffer>;
+    friend class IIODevice;
+private:
+    IIODevice dev;
+
+    IIODeviceBuffer(IIODevice dev);
+
+    const char * iio_get_attr(unsigned int idx) const;
+    unsigned int iio_get_attrs_count() const;
+    ssize_t iio_attr_read(const char *attr, char *dst, size_t len) const;
+    ssize_t iio_attr_write(const char *attr, const char *src) const;
+public:
+
+    bool operator==(IIODeviceBuffer other) const
+    {
+        return this->dev == other.dev;
+    }
+
+    bool operator!=(IIODeviceBuffer other) const
+    {
+        return !(*this == other);
+    }
+
+    /*!
+     * Get the device that these buffer attributes belong to.
+     */
+    IIODevice device(void);
+
+    /*!
+     * The attributes() method returns an object exposing the buffer
+     * attributes of the device.
+     */
+    IIOAttrs<IIODeviceBuffer> attributes(void);
+};
+
 /*!
  * IIOBuffer represents an IIO buffer, suitable for reading or writing samples
  * to or from the owning device.
@@ -246,6 +399,11 @@ private:
     std::shared_ptr<IIOContextRaw> ctx;
     struct iio_buffer *buffer;
 
+    //the data_available attribute, found on first use, and whether its
+    //backend reports bytes rather than scans
+    std::unique_ptr<IIOAttr<IIODeviceBuffer>> dataAvailableAttr;
+    bool dataAvailableInBytes;
+
     IIOBuffer(std::shared_ptr<IIOContextRaw> ctx, IIODevice *device, size_t samples_count, bool cyclic);
 
 public:
@@ -267,6 +425,30 @@ public:
      */
     int fd(void);
 
+    /*!
+     * Wait until every buffer in the set is ready to be refilled, or to be
+     * pushed if output is true.
+     *
+     * Returns false if the timeout expired before all buffers were ready,
+     * and throws if a buffer reports an error or hangup instead.
+     */
+    static bool waitAll(const std::vector<IIOBuffer *> &buffers, bool output, long long timeoutNs);
+
+    /*!
+     * Get the number of samples queued in the kernel buffer, from the
+     * device's "data_available" buffer attribute.
+     *
+     * For input buffers this is the number of samples ready to be read, and
+     * for output buffers the number of samples that can be written without
+     * blocking. If the device doesn't report it, a Pothos::RangeException
+     * will be thrown.
+     *
+     * DMA buffer backends report the attribute in bytes and kfifo backends
+     * in scans; DMA buffers are recognized by their "length_align_bytes"
+     * attribute. The attribute is looked up once per buffer.
+     */
+    size_t dataAvailable(void);
+
     /*!
      * Fill the buffer with fresh samples from the owning device.
      *
@@ -297,6 +479,11 @@ public:
      * Get the step size between two samples of one channel.
      */
     ptrdiff_t step(void);
+
+    /*!
+     * Get the address of the first sample of the given channel in the buffer.
+     */
+    void* first(IIOChannel &channel);
 };
 
 /*!
@@ -305,6 +492,7 @@ public:
 class IIOChannel {
     friend class IIOAttr<IIOChannel>;
     friend class IIOAttrs<IIOChannel>;
+    friend class IIOBuffer;
     friend class IIODevice;
 private:
     std::shared_ptr<IIOContextRaw> ctx;
@@ -349,6 +537,13 @@ public:
      */
     IIOAttrs<IIOChannel> attributes(void);
 
+    /*!
+     * Read the values of all attributes of this IIO channel at once.
+     *
+     * On remote contexts this takes a single round trip.
+     */
+    std::map<std::string, std::string> readAttributes(void);
+
     /*!
      * Enable this channel.
      */
@@ -391,9 +586,26 @@ public:
      */
     size_t write(IIOBuffer &buffer, void *dst, size_t sample_count);
 
+    /*!
+     * Convert a single raw sample of this channel, as found in an IIOBuffer,
+     * to the host format described by dtype().
+     */
+    void convert(void *dst, const void *src);
+
+    /*!
+     * Convert a single host format sample of this channel to the raw format
+     * expected in an IIOBuffer.
+     */
+    void convertInverse(void *dst, const void *src);
+
     /*!
      * Get the DType of this channel.
      */
     Pothos::DType dtype(void);
+
+    /*!
+     * Get the raw data format of this channel's samples in an IIOBuffer.
+     */
+    struct iio_data_format dataFormat(void);
 };
 
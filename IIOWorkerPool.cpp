@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include "IIOWorkerPool.hpp"
+
+IIOWorkerPool::IIOWorkerPool(size_t numThreads)
+    : jobs(nullptr), nextJob(0), pendingJobs(0), generation(0), stopping(false)
+{
+    for (size_t i = 0; i < numThreads; ++i)
+    {
+        this->threads.push_back(std::thread(&IIOWorkerPool::threadLoop, this));
+    }
+}
+
+IIOWorkerPool::~IIOWorkerPool(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->startCond.notify_all();
+    for (auto &t : this->threads)
+    {
+        t.join();
+    }
+}
+
+size_t IIOWorkerPool::size(void) const
+{
+    return this->threads.size();
+}
+
+bool IIOWorkerPool::runOne(std::unique_lock<std::mutex> &lock)
+{
+    if (!this->jobs || this->nextJob >= this->jobs->size())
+    {
+        return false;
+    }
+    const auto &job = (*this->jobs)[this->nextJob++];
+
+    //run the job without holding the lock
+    lock.unlock();
+    std::exception_ptr jobError;
+    try
+    {
+        job();
+    }
+    catch (...)
+    {
+        jobError = std::current_exception();
+    }
+    lock.lock();
+
+    if (jobError && !this->error)
+    {
+        this->error = jobError;
+    }
+    if (--this->pendingJobs == 0)
+    {
+        this->doneCond.notify_all();
+    }
+    return true;
+}
+
+void IIOWorkerPool::threadLoop(void)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    unsigned long long seen = 0;
+    while (true)
+    {
+        this->startCond.wait(lock, [this, seen]{ return this->stopping || this->generation != seen; });
+        if (this->stopping)
+        {
+            return;
+        }
+        seen = this->generation;
+        while (this->runOne(lock));
+    }
+}
+
+void IIOWorkerPool::run(const std::vector<std::function<void(void)>> &jobs)
+{
+    if (jobs.empty())
+    {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->jobs = &jobs;
+    this->nextJob = 0;
+    this->pendingJobs = jobs.size();
+    this->error = nullptr;
+    this->generation++;
+    this->startCond.notify_all();
+
+    //the calling thread helps out, then waits for the stragglers
+    while (this->runOne(lock));
+    this->doneCond.wait(lock, [this]{ return this->pendingJobs == 0; });
+    this->jobs = nullptr;
+
+    if (this->error)
+    {
+        std::exception_ptr e = this->error;
+        this->error = nullptr;
+        std::rethrow_exception(e);
+    }
+}
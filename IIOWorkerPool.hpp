@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*!
+ * IIOWorkerPool is a small fixed-size pool of threads used to run a batch
+ * of independent jobs (such as refilling several IIO buffers) in parallel.
+ *
+ * The calling thread takes part in running each batch, so a pool created
+ * with N threads runs up to N+1 jobs concurrently.
+ */
+class IIOWorkerPool
+{
+private:
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable startCond;
+    std::condition_variable doneCond;
+    const std::vector<std::function<void(void)>> *jobs;
+    size_t nextJob;
+    size_t pendingJobs;
+    unsigned long long generation;
+    bool stopping;
+    std::exception_ptr error;
+
+    void threadLoop(void);
+    bool runOne(std::unique_lock<std::mutex> &lock);
+
+public:
+    IIOWorkerPool(size_t numThreads);
+    ~IIOWorkerPool(void);
+
+    IIOWorkerPool(const IIOWorkerPool&) = delete;
+    IIOWorkerPool& operator=(const IIOWorkerPool&) = delete;
+
+    /*!
+     * Get the number of threads owned by this pool.
+     */
+    size_t size(void) const;
+
+    /*!
+     * Run every job in the batch and wait for all of them to complete.
+     *
+     * If any job throws, the first exception is rethrown from run() after
+     * the remaining jobs have finished.
+     */
+    void run(const std::vector<std::function<void(void)>> &jobs);
+};